@@ -0,0 +1,121 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bench.c
+ * \brief Cycle counter of the benchmarks.
+ */
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "uart.h"
+#include "bench.h"
+
+#ifdef __AVR__
+/*! timer 1 overflow counter */
+static volatile uint16_t bench_ovf;
+
+/*! count the timer 1 overflow */
+ISR(TIMER1_OVF_vect)
+{
+	bench_ovf++;
+}
+
+/*! enable the overflow interrupt, and the interrupts. */
+void bench_init(void)
+{
+	TIMSK1 = _BV(TOIE1);
+	sei();
+}
+
+/*! start timer 1 at F_CPU */
+void bench_start(void)
+{
+	TCCR1A = 0;
+	TCCR1B = 0;
+	TCNT1 = 0;
+	bench_ovf = 0;
+	TIFR1 = _BV(TOV1);
+	TCCR1B = _BV(CS10);
+}
+
+/*! stop timer 1 and return the cycles. */
+unsigned long bench_stop(void)
+{
+	TCCR1B = 0;
+	cli();
+
+	/* pending overflow */
+	if (TIFR1 & _BV(TOV1))
+		bench_ovf++;
+
+	TIFR1 = _BV(TOV1);
+	sei();
+
+	return(((unsigned long)bench_ovf << 16) | TCNT1);
+}
+#else
+#include "host/sim.h"
+
+/*! cycle counter at start */
+static uint64_t bench_t0;
+
+/*! nothing to set up on the host. */
+void bench_init(void)
+{
+}
+
+/*! start the measure */
+void bench_start(void)
+{
+	bench_t0 = sim_cycles();
+}
+
+/*! stop the measure and return the cycles */
+unsigned long bench_stop(void)
+{
+	return(sim_cycles() - bench_t0);
+}
+#endif
+
+/*! \brief stop the measure and add it to the counter.
+ *
+ * \param c the counter.
+ * \param overhead of an empty measure, the host cycle counter is
+ * noisy and a short measure can be below it.
+ */
+void bench_add(unsigned long *c, const unsigned long overhead)
+{
+	unsigned long cycles;
+
+	cycles = bench_stop();
+
+	if (cycles > overhead)
+		*c += cycles - overhead;
+}
+
+/*! \brief print a result on port 0, sent before the next measure.
+ *
+ * The uart sends in the background, its interrupt would be counted
+ * in the next measure. uart_shutdown() waits for the tx buffer.
+ */
+void bench_print(const char *s)
+{
+	uart_printstr(0, s);
+	uart_shutdown(0);
+	uart_init(0);
+}
@@ -0,0 +1,35 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bench.h
+ * \brief Cycle counter of the benchmarks.
+ *
+ * On the micro timer 1 counts the cpu clock, its overflows are
+ * counted by an interrupt. On the host build the PC cycle counter
+ * is used, only useful to compare two runs.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+void bench_init(void);
+void bench_start(void);
+unsigned long bench_stop(void);
+void bench_add(unsigned long *c, const unsigned long overhead);
+void bench_print(const char *s);
+
+#endif
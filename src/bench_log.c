@@ -0,0 +1,285 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bench_log.c
+ * \brief Benchmark of the log lines, sprintf_P() against streaming.
+ *
+ * A queue_list() of one element and a line of prog_list() are
+ * formatted BENCH_LOOP times each and the cycles per list are
+ * printed on the debug uart as "line,impl,cycles,check".
+ *
+ * "stream" is debug.o and queue.o as linked in the firmware: the
+ * queue line is queue_list() itself, the program line is
+ * print_program_details() on the debug_ calls of debug.o, program.o
+ * would bring in the whole firmware. "line" is the sprintf_P() into
+ * debug->line followed by uart_printstr(), with the flash strings
+ * copied by strcpy_P(), as debug.c did before, copied here.
+ *
+ * The uart is not linked, uart_putchar() and uart_printstr() below
+ * write into a RAM buffer in place of the uart tx buffer while
+ * measuring, so the uart speed is not measured. check is "ok" if
+ * both gave the same chars. The results go out on port 0 polled.
+ *
+ * make bench_log for the micro, make bench_log_host for the host,
+ * see bench.h.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "uart.h"
+#include "time.h"
+#include "debug.h"
+#include "queue.h"
+#include "journal.h"
+#include "bench.h"
+
+/*! lines formatted per measure */
+#define BENCH_LOOP 16
+/*! the output, in place of the uart tx buffer */
+#define BENCH_OUT 64
+
+/*! the output */
+static char out[BENCH_OUT];
+/*! chars in the output */
+static uint8_t outc;
+/*! measuring, the chars go to the output */
+static uint8_t sink;
+/*! the line buffer */
+static char line[80];
+/*! the string buffer */
+static char string[20];
+/*! one element in the queue, one program */
+static struct programs_t progs;
+
+/*! no io lines, always free. */
+uint8_t io_free(const uint8_t oline, struct programs_t *progs)
+{
+	return(TRUE);
+}
+
+/*! no io lines. */
+void io_set(const uint8_t oline, const uint8_t onoff, struct programs_t *progs)
+{
+}
+
+/*! no journal. */
+void journal_add(struct programs_t *progs, const uint8_t event,
+		const uint8_t oline)
+{
+}
+
+/* The uart of debug.o, port 0 only. */
+
+/*! port 0 at UART_BAUD_0, tx only. */
+void uart_init(const uint8_t port)
+{
+#ifdef __AVR__
+#if UART_BAUD_OK(UART_BAUD_0, 16)
+	UCSR0A = 0;
+	UBRR0 = UART_DIV(UART_BAUD_0, 16) - 1;
+#else
+	UCSR0A = _BV(U2X0);
+	UBRR0 = UART_DIV(UART_BAUD_0, 8) - 1;
+#endif
+	UCSR0B = _BV(TXEN0);
+	/* 8n2 */
+	UCSR0C = _BV(USBS0) | _BV(UCSZ00) | _BV(UCSZ01);
+#endif
+}
+
+/*! nothing to shutdown. */
+void uart_shutdown(const uint8_t port)
+{
+}
+
+/*! nothing to receive. */
+char uart_getchar(const uint8_t port, const uint8_t locked)
+{
+	return(0);
+}
+
+/*! a char to the output while measuring, else to port 0. */
+void uart_putchar(const uint8_t port, const char c)
+{
+	if (sink) {
+		out[outc] = c;
+		outc = (outc + 1) & (BENCH_OUT - 1);
+	} else {
+#ifdef __AVR__
+		loop_until_bit_is_set(UCSR0A, UDRE0);
+		UDR0 = c;
+#else
+		putchar(c);
+#endif
+	}
+}
+
+/*! a string, see uart_putchar(). */
+void uart_printstr(const uint8_t port, const char *s)
+{
+	while (*s)
+		uart_putchar(port, *s++);
+}
+
+/* The line, as debug.c was. */
+
+/*! as debug_print_P(), copied to the line. */
+static void line_print_P(PGM_P s)
+{
+	strcpy_P(line, s);
+	uart_printstr(0, line);
+}
+
+/*! queue_list() as it was. */
+static void line_queue(void)
+{
+	uint8_t i;
+
+	sprintf_P(line, PSTR("Queue [%02d]\n"), progs.qc);
+	uart_printstr(0, line);
+
+	for (i = 0; i < progs.qc; i++) {
+		sprintf_P(line, PSTR(" %10lu,%10lu,%1x,"), progs.q[i].start,
+				progs.q[i].stop, progs.q[i].oline);
+		uart_printstr(0, line);
+		line_print_P(PSTR("run"));
+		line_print_P(PSTR("\n"));
+	}
+}
+
+/*! print_program_details() as it was. */
+static void line_prog(const uint8_t i)
+{
+	struct program_t *p;
+
+	p = &progs.p[0];
+	sprintf_P(line, PSTR(" %02d,%02d%02d,%03d,%2x,%1x\n"), i,
+			prog_hstart(p), prog_mstart(p), prog_dmin(p),
+			prog_dow(p), prog_oline(p));
+	uart_printstr(0, line);
+}
+
+/* The stream, as debug.o is. */
+
+/*! print_program_details() as in program.c. */
+static void stream_prog(const uint8_t i, struct debug_t *debug)
+{
+	struct program_t *p;
+
+	p = &progs.p[0];
+	debug_putc(' ', debug);
+	debug_print_num(i, 10, 2, '0', debug);
+	debug_putc(',', debug);
+	debug_print_num(prog_hstart(p), 10, 2, '0', debug);
+	debug_print_num(prog_mstart(p), 10, 2, '0', debug);
+	debug_putc(',', debug);
+	debug_print_num(prog_dmin(p), 10, 3, '0', debug);
+	debug_putc(',', debug);
+	debug_print_num(prog_dow(p), 16, 2, ' ', debug);
+	debug_putc(',', debug);
+	debug_print_num(prog_oline(p), 16, 1, ' ', debug);
+	debug_putc('\n', debug);
+}
+
+/*! \brief format the lines.
+ *
+ * \param prog a program line, else the queue list.
+ * \param stream the stream, else the line.
+ * \param debug active.
+ * \return the cycles per line.
+ */
+static unsigned long bench(const uint8_t prog, const uint8_t stream,
+		struct debug_t *debug)
+{
+	unsigned long overhead, cycles;
+	uint8_t i;
+
+	sink = TRUE;
+	outc = 0;
+	cycles = 0;
+	bench_start();
+	overhead = bench_stop();
+	bench_start();
+
+	for (i = 0; i < BENCH_LOOP; i++) {
+		outc = 0;
+
+		if (prog && stream)
+			stream_prog(i, debug);
+		else if (prog)
+			line_prog(i);
+		else if (stream)
+			queue_list(&progs, debug);
+		else
+			line_queue();
+	}
+
+	bench_add(&cycles, overhead);
+	sink = FALSE;
+
+	return(cycles / BENCH_LOOP);
+}
+
+/*! main */
+int main(void)
+{
+	struct debug_t debug;
+	unsigned long cline, cstream;
+	char ref[BENCH_OUT];
+	uint8_t prog, check;
+
+	uart_init(0);
+	bench_init();
+	debug.line = line;
+	debug.string = string;
+	debug.active = TRUE;
+	debug.level = LOG_DEBUG;
+	prog_set(&progs.p[0], 23, 59, 120, 0x7f, 3);
+	progs.q[0].start = 1400000000UL;
+	progs.q[0].stop = progs.q[0].start + 600;
+	progs.q[0].oline = 3;
+	progs.q[0].status = Q_RUN;
+	progs.qc = 1;
+	uart_printstr(0, "line,impl,cycles,check\n");
+
+	for (prog = 0; prog < 2; prog++) {
+		cline = bench(prog, FALSE, &debug);
+		memcpy(ref, out, outc);
+		check = outc;
+		cstream = bench(prog, TRUE, &debug);
+		check = (check == outc) && !memcmp(ref, out, outc);
+
+		/* the results in the 80 bytes line, string is too short */
+		sprintf_P(line, PSTR("%s,line,%lu,%s\n"),
+				prog ? "prog" : "queue", cline,
+				check ? "ok" : "DIFF");
+		uart_printstr(0, line);
+		sprintf_P(line, PSTR("%s,stream,%lu,%s\n"),
+				prog ? "prog" : "queue", cstream,
+				check ? "ok" : "DIFF");
+		uart_printstr(0, line);
+	}
+
+#ifdef __AVR__
+	while (1);
+#endif
+
+	return(0);
+}
@@ -0,0 +1,253 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bench_queue.c
+ * \brief Benchmark of the queue, linear array against min-heap.
+ *
+ * The queue is filled with n elements with pseudo random start
+ * times, then it is run until empty, each element is opened and
+ * later closed. The cycles are printed on the debug uart as
+ * "n,impl,push,next,run": push an element, peek the next deadline,
+ * and the passes which open and close an element, per element.
+ *
+ * "array" is the unordered array walked and shifted as queue.c did
+ * before the heap, copied here since it is no longer in the tree.
+ * "heap" is queue.c itself, included for q_insert() and q_run().
+ * Both get the start and the stop in seconds, the mktime() of
+ * q_push() and queue_run() is not timed.
+ *
+ * Both work on progs.q, the bench is built with MAX_QUEUE set to
+ * BENCH_QUEUE of the Makefile, a longer n is cut to it. The micro
+ * has the RAM for about 100 elements.
+ *
+ * The io lines and the journal are not linked, io_set(), io_free()
+ * and journal_add() below do nothing, the EEPROM writes of the
+ * journal would be timed else.
+ *
+ * make bench_queue for the micro, make bench_queue_host for the
+ * host, see bench.h.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "uart.h"
+#include "time.h"
+#include "queue.c"
+#include "journal.h"
+#include "bench.h"
+
+/*! the programs, the queue of both */
+static struct programs_t progs;
+/*! the seed of the pseudo random start times */
+static uint32_t seed;
+
+/*! no io lines, always free. */
+uint8_t io_free(const uint8_t oline, struct programs_t *progs)
+{
+	return(TRUE);
+}
+
+/*! no io lines. */
+void io_set(const uint8_t oline, const uint8_t onoff, struct programs_t *progs)
+{
+}
+
+/*! no journal. */
+void journal_add(struct programs_t *progs, const uint8_t event,
+		const uint8_t oline)
+{
+}
+
+/*! next pseudo random start time, within a day. */
+static time_t bench_rand(void)
+{
+	seed = seed * 1103515245UL + 12345UL;
+	return(1400000000UL + (seed >> 8) % 86400UL);
+}
+
+/* The array, as queue.c was. */
+
+/*! push at the end. */
+static void array_push(const time_t start, const time_t stop,
+		const uint8_t oline)
+{
+	progs.q[progs.qc].start = start;
+	progs.q[progs.qc].stop = stop;
+	progs.q[progs.qc].oline = oline;
+	progs.q[progs.qc].status = Q_NEW;
+	progs.qc++;
+}
+
+/*! earliest start of a waiting element or stop of a running one. */
+static time_t array_next(void)
+{
+	uint8_t i;
+	time_t t, next;
+
+	next = 0;
+
+	for (i = 0; i < progs.qc; i++) {
+		if (progs.q[i].status == Q_RUN)
+			t = progs.q[i].stop;
+		else if (progs.q[i].status == Q_OFF)
+			continue;
+		else
+			t = progs.q[i].start;
+
+		if (!next || (t < next))
+			next = t;
+	}
+
+	return(next);
+}
+
+/*! shift down the elements after i. */
+static void array_pop(const uint8_t i)
+{
+	uint8_t j;
+
+	for (j = i + 1; j < progs.qc; j++)
+		progs.q[j - 1] = progs.q[j];
+
+	progs.qc--;
+}
+
+/*! one pass of the queue, open or close the first element due. */
+static void array_run(const time_t tnow)
+{
+	uint8_t i;
+	uint8_t exit;
+
+	exit = FALSE;
+
+	for (i = 0; (i < progs.qc) && !exit; i++)
+		if (progs.q[i].start <= tnow) {
+			if (progs.q[i].status == Q_NEW) {
+				progs.q[i].stop += tnow - progs.q[i].start;
+				progs.q[i].start = tnow;
+				progs.q[i].status = Q_RUN;
+				exit = TRUE;
+			} else if ((progs.q[i].status == Q_RUN) &&
+					(progs.q[i].stop <= tnow)) {
+				progs.q[i].status = Q_OFF;
+				exit = TRUE;
+			}
+		}
+
+	/* purge */
+	i = 0;
+
+	while (i < progs.qc)
+		if (progs.q[i].status == Q_OFF)
+			array_pop(i);
+		else
+			i++;
+}
+
+/*! \brief fill and empty the queue.
+ *
+ * \param n number of elements.
+ * \param heap use queue.c or the array.
+ * \param debug inactive, nothing is printed by q_run().
+ * \param line output buffer.
+ */
+static void bench(const uint8_t n, const uint8_t heap,
+		struct debug_t *debug, char *line)
+{
+	unsigned long overhead, cpush, cnext, crun;
+	uint16_t passes;
+	uint8_t i;
+	time_t t;
+
+	bench_start();
+	overhead = bench_stop();
+	cpush = 0;
+	cnext = 0;
+	crun = 0;
+	passes = 0;
+	progs.qc = 0;
+	seed = n;
+
+	/* 10 minutes on line i */
+	for (i = 0; i < n; i++) {
+		t = bench_rand();
+		bench_start();
+
+		if (heap)
+			q_insert(&progs, t, t + 600, i & 7);
+		else
+			array_push(t, t + 600, i & 7);
+
+		bench_add(&cpush, overhead);
+	}
+
+	while (progs.qc) {
+		bench_start();
+
+		if (heap)
+			t = queue_next(&progs);
+		else
+			t = array_next();
+
+		bench_add(&cnext, overhead);
+		bench_start();
+
+		if (heap)
+			q_run(&progs, t, debug);
+		else
+			array_run(t);
+
+		bench_add(&crun, overhead);
+		passes++;
+	}
+
+	sprintf_P(line, PSTR("%u,%s,%lu,%lu,%lu\n"), n,
+			heap ? "heap" : "array", cpush / n,
+			cnext / passes, crun / n);
+}
+
+/*! main */
+int main(void)
+{
+	const uint8_t size[] = { 20, 64, 255 };
+	struct debug_t debug;
+	uint8_t i, n;
+	char line[40];
+
+	uart_init(0);
+	bench_init();
+	debug.active = FALSE;
+	debug.level = LOG_NONE;
+
+	bench_print("n,impl,push,next,run\n");
+
+	for (i = 0; i < sizeof(size); i++) {
+		n = (size[i] > MAX_QUEUE) ? MAX_QUEUE : size[i];
+		bench(n, FALSE, &debug, line);
+		bench_print(line);
+		bench(n, TRUE, &debug, line);
+		bench_print(line);
+	}
+
+#ifdef __AVR__
+	while (1);
+#endif
+
+	return(0);
+}
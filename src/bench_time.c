@@ -0,0 +1,120 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file bench_time.c
+ * \brief Benchmark of the gmtime() and mktime() conversions.
+ *
+ * For every year in the time_t range the 1st of July at noon is
+ * converted back and forth and the cycles per call are printed
+ * on the debug uart as "year,gmtime,mktime", followed by the
+ * worst case. Each line is sent before the next measure starts.
+ *
+ * make bench for the micro, make bench_host for the host, see
+ * bench.h. On the host the cycles are averaged over BENCH_LOOP
+ * calls.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "uart.h"
+#include "time.h"
+#include "bench.h"
+
+/*! first year benchmarked */
+#define BENCH_FIRST_YEAR 1970
+/*! last year benchmarked, time_t ends on Feb 2106 */
+#define BENCH_LAST_YEAR 2105
+
+#ifdef __AVR__
+/*! calls per measure */
+#define BENCH_LOOP 1
+#else
+/*! calls per measure */
+#define BENCH_LOOP 10000
+#endif
+
+/*! main */
+int main(void)
+{
+	struct tm tm_date;
+	time_t t;
+	volatile time_t check;
+	unsigned long overhead, cg, cm, cg_max, cm_max;
+	unsigned int year, i;
+	char line[40];
+
+	uart_init(0);
+	bench_init();
+
+	bench_start();
+	overhead = bench_stop();
+	cg_max = 0;
+	cm_max = 0;
+
+	bench_print("year,gmtime,mktime\n");
+
+	for (year = BENCH_FIRST_YEAR; year <= BENCH_LAST_YEAR; year++) {
+		tm_date.tm_year = year - 1900;
+		tm_date.tm_mon = 6;
+		tm_date.tm_mday = 1;
+		tm_date.tm_hour = 12;
+		tm_date.tm_min = 0;
+		tm_date.tm_sec = 0;
+		tm_date.tm_wday = 0;
+		t = mktime(&tm_date);
+
+		bench_start();
+
+		for (i = 0; i < BENCH_LOOP; i++)
+			gmtime(&t);
+
+		cg = (bench_stop() - overhead) / BENCH_LOOP;
+
+		tm_date = *gmtime(&t);
+		bench_start();
+
+		for (i = 0; i < BENCH_LOOP; i++)
+			check = mktime(&tm_date);
+
+		cm = (bench_stop() - overhead) / BENCH_LOOP;
+
+		if (check != t) {
+			sprintf_P(line, PSTR("%u,ERROR\n"), year);
+		} else {
+			sprintf_P(line, PSTR("%u,%lu,%lu\n"), year, cg, cm);
+
+			if (cg > cg_max)
+				cg_max = cg;
+
+			if (cm > cm_max)
+				cm_max = cm;
+		}
+
+		bench_print(line);
+	}
+
+	sprintf_P(line, PSTR("max,%lu,%lu\n"), cg_max, cm_max);
+	bench_print(line);
+
+#ifdef __AVR__
+	while (1);
+#endif
+
+	return(0);
+}
@@ -33,12 +33,15 @@ void sunsite_cmd(struct programs_t *progs, struct debug_t *debug, const char c)
 {
 	switch (c) {
 		case '0': progs->position = FULLSUN;
+			  store_dirty(STORE_SETTINGS);
 			  debug_print_P(PSTR("OK\n"), debug);
 			  break;
 		case '1': progs->position = HALFSUN;
+			  store_dirty(STORE_SETTINGS);
 			  debug_print_P(PSTR("OK\n"), debug);
 			  break;
 		case '2': progs->position = SHADOW;
+			  store_dirty(STORE_SETTINGS);
 			  debug_print_P(PSTR("OK\n"), debug);
 			  break;
 		case 0:
@@ -70,10 +73,12 @@ void valve_cmd(struct programs_t *progs, struct debug_t *debug, const char c)
 	switch (c) {
 		case '1':
 			progs->valve = MONOSTABLE;
+			store_dirty(STORE_SETTINGS);
 			debug_print_P(PSTR("OK\n"), debug);
 			break;
 		case '2':
 			progs->valve = BISTABLE;
+			store_dirty(STORE_SETTINGS);
 			debug_print_P(PSTR("OK\n"), debug);
 			break;
 		case 0:
@@ -87,6 +92,27 @@ void valve_cmd(struct programs_t *progs, struct debug_t *debug, const char c)
 	}
 }
 
+/*! Set or print the output lines open at the same time.
+ *
+ * \param progs ptr to the programs.
+ * \param debug ptr to the print space.
+ * \param s what follows the command.
+ * \note used with monostable valves only, bistable open one line.
+ */
+void lines_cmd(struct programs_t *progs, struct debug_t *debug, const char *s)
+{
+	if (!*s) {
+		debug_print_num(progs->lines, 10, 0, ' ', debug);
+		debug_putc('\n', debug);
+	} else if ((*s >= '1') && (*s <= '0' + MAX_LINES) && !*(s + 1)) {
+		progs->lines = *s - '0';
+		store_dirty(STORE_SETTINGS);
+		debug_print_P(PSTR("OK\n"), debug);
+	} else {
+		debug_print_P(PSTR("ERROR\n"), debug);
+	}
+}
+
 /*! Clear the cli_t struct */
 void cmdli_clear(struct cmdli_t *cmdli)
 {
@@ -94,21 +120,63 @@ void cmdli_clear(struct cmdli_t *cmdli)
 	cmdli->idx = 0;
 }
 
-/*! initialize the struct cli and allocate memory. */
+/*! initialize the struct cli, static as its buffer. */
 struct cmdli_t *cmdli_init(struct cmdli_t *cmdli)
 {
+	static struct cmdli_t cmdli_pool;
+	static char cmd[MAX_CMD_LENGHT];
+
 	temperature_init();
-	cmdli = malloc(sizeof(struct cmdli_t));
-	cmdli->cmd = malloc(MAX_CMD_LENGHT);
+	cmdli = &cmdli_pool;
+	cmdli->cmd = cmd;
 	cmdli_clear(cmdli);
 	return(cmdli);
 }
 
-/*! Free the struct from memory. */
-void cmdli_free(struct cmdli_t *cmdli)
+/*! \brief Set or print the baud rate of the command line.
+ *
+ * The new rate is checked against UART_BAUD_TOL, the OK is sent at
+ * the old rate, the next command is expected at the new one.
+ *
+ * \param cmd the rate, empty to print the rate in use.
+ * \param debug ptr to the print space.
+ */
+static void baud_cmd(const char *cmd, struct debug_t *debug)
 {
-	free(cmdli->cmd);
-	free(cmdli);
+	struct parse_t ps;
+	uint32_t baud;
+	uint16_t ubrr;
+	int16_t err;
+
+	if (*cmd) {
+		parse_init(&ps, cmd);
+		baud = parse_num(&ps, 0, 10, F_CPU);
+
+		if (!parse_end(&ps) || !baud) {
+			debug_print_P(PSTR("ERROR\n"), debug);
+			return;
+		}
+	} else {
+		baud = uart_baud_get(0);
+	}
+
+	err = uart_ubrr(baud, &ubrr);
+
+	sprintf_P(debug->line, PSTR("%lu %c%d.%d%% UBRR %u%s\n"),
+			(unsigned long)baud, err < 0 ? '-' : '+',
+			abs(err) / 10, abs(err) % 10, ubrr & ~UART_U2X,
+			(ubrr & UART_U2X) ? " U2X" : "");
+	debug_print(debug);
+
+	if (!*cmd)
+		return;
+
+	if ((err > UART_BAUD_TOL) || (err < -UART_BAUD_TOL)) {
+		debug_print_P(PSTR("ERROR\n"), debug);
+	} else {
+		debug_print_P(PSTR("OK\n"), debug);
+		uart_baud(0, baud);
+	}
 }
 
 /*! Print the help. */
@@ -117,15 +185,18 @@ void cmdli_help(struct debug_t *debug)
 	debug_print_P(PSTR("Help command:\n"), debug);
 	debug_print_P(PSTR("a[L | H] - Alarm LOW/HIGH.\n"), debug);
 	debug_print_P(PSTR("A - Print the alarm status.\n"), debug);
+	debug_print_P(PSTR("b[baud] - print or set the baud rate, not saved.\n"), debug);
 	debug_print_P(PSTR("C - clear all programs from memory.\n"), debug);
 	debug_print_P(PSTR("d[seconds] - print or set the absolute time. TimeZones not supported!\n"), debug);
 	debug_print_P(PSTR("DNN - delete program number NN.\n"), debug);
 	debug_print_P(PSTR("e[0 | 1] - led OFF/ON\n"), debug);
 	debug_print_P(PSTR("g - Print the temperature.\n"), debug);
+	debug_print_P(PSTR("j - dump the journal of the events.\n"), debug);
 	debug_print_P(PSTR("l - list programs.\n"), debug);
-	debug_print_P(PSTR("L[0 | 1] - logs OFF/ON\n"), debug);
+	debug_print_P(PSTR("L[0..3] - log level: off, errors, programs, queue and temperature.\n"), debug);
+	debug_print_P(PSTR("o[1..8] - print or set the lines open at the same time, monostable.\n"), debug);
 	debug_print_P(PSTR("pShSm,dtime,DD,OL\n"), debug);
-	debug_print_P(PSTR(" where Sh [0..24], Sm [0..60], dtime [000-999], DD [0..FF] OL [0..7]\n"), debug);
+	debug_print_P(PSTR(" where Sh [0..23], Sm [0..59], dtime [0..999], DD [0..7F] OL [0..7]\n"), debug);
 	debug_print_P(PSTR("q - queue list.\n"), debug);
 	debug_print_P(PSTR("r - load programs from EEPROM.\n"), debug);
 	debug_print_P(PSTR("s - save programs to EEPROM.\n"), debug);
@@ -134,6 +205,7 @@ void cmdli_help(struct debug_t *debug)
 	debug_print_P(PSTR("V[1 | 2] - Valve type: 1 Monostable, 2 Bistable.\n"), debug);
 	debug_print_P(PSTR("y[0..2] - print or set the sun site.\n"), debug);
 	debug_print_P(PSTR("? - this help screen.\n"), debug);
+	debug_print_P(PSTR("0x02 at the start of a line - binary frame.\n"), debug);
 }
 
 /*! Execute an input command:
@@ -144,6 +216,7 @@ void cmdli_help(struct debug_t *debug)
  */
 void cmdli_run(char *cmd, struct programs_t *progs, struct debug_t *debug)
 {
+	struct parse_t ps;
 	uint8_t tmp;
 
 	switch (*cmd) {
@@ -174,6 +247,9 @@ void cmdli_run(char *cmd, struct programs_t *progs, struct debug_t *debug)
 			else
 				debug_print_P(PSTR("OFF\n"), debug);
 
+			break;
+		case 'b':
+			baud_cmd(cmd + 1, debug);
 			break;
 		case 'C':
 			prog_clear(progs);
@@ -182,17 +258,20 @@ void cmdli_run(char *cmd, struct programs_t *progs, struct debug_t *debug)
 		case 'd':
 			/* strip the string from the 1st char */
 			if (*(cmd + 1)) {
-				date_setrtc(cmd + 1);
-				debug_print_P(PSTR("OK\n"), debug);
+				if (date_setrtc(cmd + 1))
+					debug_print_P(PSTR("OK\n"), debug);
+				else
+					debug_print_P(PSTR("ERROR\n"), debug);
 			} else {
 				date_rtc(debug);
 			}
 
 			break;
 		case 'D':
-			tmp = strtoul((cmd+1), 0, 10);
+			parse_init(&ps, cmd + 1);
+			tmp = parse_num(&ps, 0, 10, MAX_PROGS - 1);
 
-			if (prog_del(progs, tmp))
+			if (parse_end(&ps) && prog_del(progs, tmp))
 				debug_print_P(PSTR("OK\n"), debug);
 			else
 				debug_print_P(PSTR("ERROR\n"), debug);
@@ -217,31 +296,38 @@ void cmdli_run(char *cmd, struct programs_t *progs, struct debug_t *debug)
 
 			break;
 		case 'g':
+			temperature_fold(progs);
 			temperature_print(progs, debug);
 			break;
+		case 'j':
+			journal_dump(debug);
+			break;
 		case 'l':
 			prog_list(progs, debug);
 			break;
 		case 'L':
-			switch (*(cmd + 1)) {
-				case '0':
-					flag_set(progs, FL_LOG, FALSE);
-					debug_print_P(PSTR("OK\n"), debug);
-					break;
-				case '1':
-					flag_set(progs, FL_LOG, TRUE);
-					debug_print_P(PSTR("OK\n"), debug);
-					break;
-				default:
-					if (flag_get(progs, FL_LOG))
-						debug_print_P(PSTR("ON\n"), debug);
-					else
-						debug_print_P(PSTR("OFF\n"), debug);
+			if ((*(cmd + 1) >= '0') && (*(cmd + 1) <= '0' + LOG_LEVEL) &&
+					!*(cmd + 2)) {
+				debug->level = *(cmd + 1) - '0';
+				debug_print_P(PSTR("OK\n"), debug);
+			} else if (*(cmd + 1)) {
+				debug_print_P(PSTR("ERROR\n"), debug);
+			} else {
+				sprintf_P(debug->line, PSTR("%u of %u\n"),
+						debug->level, LOG_LEVEL);
+				debug_print(debug);
 			}
 
+			break;
+		case 'o':
+			lines_cmd(progs, debug, cmd + 1);
 			break;
 		case 'p':
-			prog_add(progs, cmd);
+			if (prog_add(progs, cmd))
+				debug_print_P(PSTR("OK\n"), debug);
+			else
+				debug_print_P(PSTR("ERROR\n"), debug);
+
 			break;
 		case 'q':
 			queue_list(progs, debug);
@@ -256,11 +342,14 @@ void cmdli_run(char *cmd, struct programs_t *progs, struct debug_t *debug)
 			break;
 		case 't':
 			/* strip the string from the 1st char */
-			if (*(cmd + 1))
-				date_set(cmd + 1, debug);
-			else
+			if (!*(cmd + 1))
 				date(debug);
-			break;	
+			else if (date_set(cmd + 1))
+				debug_print_P(PSTR("OK\n"), debug);
+			else
+				debug_print_P(PSTR("ERROR\n"), debug);
+
+			break;
 		case 'v':
 			debug_version(debug);
 			break;
@@ -281,6 +370,10 @@ void cmdli_run(char *cmd, struct programs_t *progs, struct debug_t *debug)
 /*! Get a char from the users and echo it, compose the command line and,
  * if an \\r is entered, execute the command.
  *
+ * A FRAME_STX at the start of the line is a binary frame, its
+ * chars go to frame_rx() without echo up to the end of the frame.
+ * The 0 chars of the text are dropped.
+ *
  * \param c input char,
  * \param cmdli struct with the command line string,
  * \param progs the programs structure,
@@ -288,6 +381,17 @@ void cmdli_run(char *cmd, struct programs_t *progs, struct debug_t *debug)
  */
 void cmdli_exec(char c, struct cmdli_t *cmdli, struct programs_t *progs, struct debug_t *debug)
 {
+	if (frame_active() || (!cmdli->idx && (c == FRAME_STX))) {
+		frame_rx(c, progs);
+		return;
+	}
+
+	if (!c)
+		return;
+
+	/* echo */
+	uart_putchar(0, c);
+
 	if (c == '\n') {
 		/* debug_print_P(PSTR("\n"), debug); */
 		*(cmdli->cmd + cmdli->idx) = 0;
@@ -27,6 +27,7 @@
 #include "temperature.h"
 #include "program.h"
 #include "queue.h"
+#include "frame.h"
 
 /*! maximum chars a command is made of */
 #define MAX_CMD_LENGHT 20
@@ -40,7 +41,6 @@ struct cmdli_t {
 };
 
 struct cmdli_t *cmdli_init(struct cmdli_t *cmdli);
-void cmdli_free(struct cmdli_t *cmdli);
 void cmdli_help(struct debug_t *debug);
 void cmdli_run(char *cmd, struct programs_t *progs, struct debug_t *debug);
 void cmdli_exec(char c, struct cmdli_t *cmdli, struct programs_t *progs, struct debug_t *debug);
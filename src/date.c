@@ -22,50 +22,62 @@
 #include <util/delay.h>
 #include "uart.h"
 #include "date.h"
+#include "ogstruct.h"
 
 /*! \file date.c */
 
 /*! Set the date from the command line in a human form.
  * \param cmd the string in the format YYYYMMDDhhmm.
- * \param debug printing and string stuff.
+ * \return FALSE if the date is not valid.
  */
-void date_set(char *cmd, struct debug_t *debug)
+uint8_t date_set(const char *cmd)
 {
+	struct parse_t ps;
+	struct tm tm_date;
 	struct tm *date;
 	time_t sec;
 
-	date = malloc(sizeof(struct tm));
-
-	/* Year */
-	strlcpy(debug->string, cmd, 5);
-	date->tm_year = atoi(debug->string) - 1900;
+	date = &tm_date;
+	parse_init(&ps, cmd);
+	/* Year, the time_t ends in 2106 */
+	date->tm_year = parse_num(&ps, 4, 10, 2105) - 1900;
 	/* Month */
-	strlcpy(debug->string, cmd + 4, 3);
-	date->tm_mon = atoi(debug->string) - 1;
+	date->tm_mon = parse_num(&ps, 2, 10, 12) - 1;
 	/* Day */
-	strlcpy(debug->string, cmd + 6, 3);
-	date->tm_mday = atoi(debug->string);
+	date->tm_mday = parse_num(&ps, 2, 10, 31);
 	/* Hour */
-	strlcpy(debug->string, cmd + 8, 3);
-	date->tm_hour = atoi(debug->string);
+	date->tm_hour = parse_num(&ps, 2, 10, 23);
 	/* Minute */
-	strlcpy(debug->string, cmd + 10, 3);
-	date->tm_min = atoi(debug->string);
+	date->tm_min = parse_num(&ps, 2, 10, 59);
 	date->tm_sec = 0;
 
+	if (!parse_end(&ps) || (date->tm_year < 70) ||
+			(date->tm_mon > 11) || !date->tm_mday)
+		return(FALSE);
+
 	sec = mktime(date);
 	settimeofday(sec);
-
-	free(date);
+	return(TRUE);
 }
 
-/*! Extract abstime from the command and set it to the RTC clock */
-void date_setrtc(char *cmd)
+/*! Extract abstime from the command and set it to the RTC clock
+ *
+ * \param cmd the seconds since the epoch.
+ * \return FALSE if not a valid time.
+ */
+uint8_t date_setrtc(const char *cmd)
 {
+	struct parse_t ps;
 	time_t sec;
 
-	sec = strtoul(cmd, NULL, 10);
+	parse_init(&ps, cmd);
+	sec = parse_num(&ps, 0, 10, 0xffffffffUL);
+
+	if (!parse_end(&ps))
+		return(FALSE);
+
 	settimeofday(sec);
+	return(TRUE);
 }
 
 /*! print the current rtc time */
@@ -74,9 +86,8 @@ void date_rtc(struct debug_t *debug)
 	time_t clock;
 
 	clock = time(NULL);
-	debug->line = ultoa(clock, debug->line, 10);
-	debug_print(debug);
-	debug_print_P(PSTR("\n"), debug);
+	debug_print_num(clock, 10, 0, ' ', debug);
+	debug_putc('\n', debug);
 }
 
 /*! print the current time */
@@ -85,11 +96,9 @@ void date(struct debug_t *debug)
 	time_t clock;
 
 	clock = time(NULL);
-	strcpy(debug->line, ctime(&clock));
-	debug_print(debug);
+	debug_print_str(ctime(&clock), debug);
 	debug_print_P(PSTR(" ("), debug);
-	debug->line = ultoa(clock, debug->line, 10);
-	debug_print(debug);
+	debug_print_num(clock, 10, 0, ' ', debug);
 	debug_print_P(PSTR(")\n"), debug);
 }
 
@@ -112,12 +121,6 @@ struct tm *date_init(struct tm *tm_clock, struct debug_t *debug)
 	return(tm_clock);
 }
 
-/*! free the allocated structure */
-void date_free(struct tm *tm_clock)
-{
-	free(tm_clock);
-}
-
 /*! start the hardware clock now, high level call to rtc start. */
 void date_hwclock_start(void)
 {
@@ -146,15 +149,13 @@ void date_hwclock_stop(void)
  */
 uint8_t date_timetorun(struct tm *tm_clock, struct debug_t *debug)
 {
-	time_t clock;
 	/*! static store at which last time (minutes)
 	 * we run programs, needed to avoid
 	 * re-execution of programs in the same minute.
 	 */
 	static uint8_t flag = 99;
 
-	clock = gettimeofday();
-	tm_clock = gmtime(&clock);
+	tm_clock = gmtime_now();
 
 	if (flag != tm_clock->tm_min) {
 		flag = tm_clock->tm_min;
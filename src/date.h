@@ -24,11 +24,11 @@
 
 #include "debug.h"
 #include "time.h"
+#include "parse.h"
 
-void date_set(char *cmd, struct debug_t *debug);
-void date_setrtc(char *cmd);
+uint8_t date_set(const char *cmd);
+uint8_t date_setrtc(const char *cmd);
 struct tm *date_init(struct tm *tm_clock, struct debug_t *debug);
-void date_free(struct tm *tm_clock);
 void date_rtc(struct debug_t *debug);
 void date(struct debug_t *debug);
 void date_hwclock_start(void);
@@ -40,17 +40,79 @@ void debug_get_str(char *str)
 	*(str + i) = 0;
 }
 
+/*! Print a char to the terminal. */
+void debug_putc(const char c, struct debug_t *debug)
+{
+	if (debug->active)
+		uart_putchar(0, c);
+}
+
 /*! Print a flash-stored string to the terminal.
+ *
+ * The chars go from the flash straight to the uart tx buffer.
  *
  * \param string MUST be a PSTR() string.
  * \param debug ptr to print space.
  */
 void debug_print_P(PGM_P string, struct debug_t *debug)
 {
-	if (debug->active) {
-		strcpy_P(debug->line, string);
-		uart_printstr(0, debug->line);
+	char c;
+
+	if (debug->active)
+		while ((c = pgm_read_byte(string++)))
+			uart_putchar(0, c);
+}
+
+/*! Print a RAM string to the terminal. */
+void debug_print_str(const char *s, struct debug_t *debug)
+{
+	if (debug->active)
+		uart_printstr(0, s);
+}
+
+/*! \brief Print a number to the terminal.
+ *
+ * The digits are built backward in a few bytes of stack, a 16 bit
+ * number is divided with 16 bit math, faster on the micro than the
+ * 32 bit one sprintf_P() uses for %lu.
+ *
+ * \param n the number.
+ * \param base 10 or 16, lowercase hex.
+ * \param width min number of chars, up to 10.
+ * \param pad the char on the left up to width, ' ' or '0'.
+ * \param debug
+ */
+void debug_print_num(uint32_t n, const uint8_t base, const uint8_t width,
+		const char pad, struct debug_t *debug)
+{
+	char buf[10];
+	uint8_t i, d;
+	uint16_t m;
+
+	if (!debug->active)
+		return;
+
+	i = sizeof(buf);
+
+	while (n > 0xffff) {
+		d = n % base;
+		n /= base;
+		buf[--i] = d < 10 ? '0' + d : 'a' - 10 + d;
 	}
+
+	m = n;
+
+	do {
+		d = m % base;
+		m /= base;
+		buf[--i] = d < 10 ? '0' + d : 'a' - 10 + d;
+	} while (m);
+
+	for (d = sizeof(buf) - i; (d < width) && (d < sizeof(buf)); d++)
+		uart_putchar(0, pad);
+
+	while (i < sizeof(buf))
+		uart_putchar(0, buf[i++]);
 }
 
 /*! Print the debug->line string. */
@@ -121,23 +183,19 @@ void debug_stop(struct debug_t *debug)
 
 /*! Initialize the debug_t structure and ask if
  * debug is active.
+ *
+ * The structure and its buffers are static, there is only one.
  */
 struct debug_t *debug_init(struct debug_t *debug)
 {
-	debug = malloc(sizeof(struct debug_t));
-	debug->line = malloc(MAX_LINE_LENGHT);
-	debug->string = malloc(MAX_STRING_LENGHT);
+	static struct debug_t debug_pool;
+	static char line[MAX_LINE_LENGHT];
+	static char string[MAX_STRING_LENGHT];
+
+	debug = &debug_pool;
+	debug->line = line;
+	debug->string = string;
+	debug->level = LOG_NONE;
 	debug_start(debug);
 	return(debug);
 }
-
-/*! Free the allocated structure. */
-void debug_free(struct debug_t *debug)
-{
-	if (debug->active) {
-		free(debug->string);
-		free(debug->line);
-	}
-
-	free(debug);
-}
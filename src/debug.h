@@ -47,6 +47,38 @@ conversions have to be made from int to string etc. */
 /*! Seconds to wait for an answer (y/n) */
 #define SEC_FOR_Y 5
 
+/*! log level: nothing. */
+#define LOG_NONE 0
+/*! log level: errors, the alarm. */
+#define LOG_ERROR 1
+/*! log level: the programs executed. */
+#define LOG_INFO 2
+/*! log level: the queue changes and the temperature, every run. */
+#define LOG_DEBUG 3
+
+#ifndef LOG_LEVEL
+/*! \brief highest log level built in, see the Makefile.
+ *
+ * The log sites above it are removed by the compiler, with the
+ * formatting code only they use.
+ */
+#define LOG_LEVEL LOG_DEBUG
+#endif
+
+/*! \brief a message of level lvl has to be printed.
+ *
+ * 0 at compile time above LOG_LEVEL, so the block it guards is
+ * dropped, else nothing is formatted with the PC disconnected or
+ * below the runtime level.
+ */
+#define LOG_ON(lvl, debug) ((LOG_LEVEL >= (lvl)) && (debug)->active && \
+		((debug)->level >= (lvl)))
+/*! print a flash string at a log level. */
+#define LOG_P(lvl, debug, s) do { \
+	if (LOG_ON(lvl, debug)) \
+		debug_print_P(PSTR(s), debug); \
+	} while (0)
+
 /*! GITREL Environment check */
 #ifndef GITREL
 #define GITREL "unknown"
@@ -63,16 +95,21 @@ struct debug_t {
 	char *string;
 	/*! is debug active, shall we print the output? */
 	uint8_t active;
+	/*! runtime log level, LOG_NONE up to LOG_LEVEL. */
+	uint8_t level;
 };
 
 void debug_get_str(char *str);
+void debug_putc(const char c, struct debug_t *debug);
 void debug_print_P(PGM_P string, struct debug_t *debug);
+void debug_print_str(const char *s, struct debug_t *debug);
+void debug_print_num(uint32_t n, const uint8_t base, const uint8_t width,
+		const char pad, struct debug_t *debug);
 void debug_print(struct debug_t *debug);
 void debug_version(struct debug_t *debug);
 uint8_t debug_wait_for_y(struct debug_t *debug);
 void debug_start(struct debug_t *debug);
 void debug_stop(struct debug_t *debug);
 struct debug_t *debug_init(struct debug_t *debug);
-void debug_free(struct debug_t *debug);
 
 #endif
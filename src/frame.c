@@ -0,0 +1,394 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file frame.c
+ * \brief Binary framed commands.
+ *
+ * Next to the text command line, to read and write the whole
+ * program table, the settings and the queue without typing a
+ * command per program. A frame is:
+ *
+ * STX, len, opcode, payload (len - 1 bytes), CRC low, CRC high
+ *
+ * len counts the opcode and the payload, 1..FRAME_MAX_LEN, the
+ * CRC-CCITT (0xffff) covers len, opcode and payload. A frame starts
+ * with FRAME_STX at the beginning of a command line, it is not
+ * echoed. Every frame has a reply frame with the same opcode, the
+ * payload starts with a status FRAME_OK or an error, then the data.
+ * Multi byte numbers are little endian, the programs are the
+ * records of struct program_t.
+ *
+ * The PC sends the next frame after the reply, the rx buffer is
+ * shorter than a frame. A frame cut short swallows what follows,
+ * FRAME_MAX_LEN + 3 zeros bring the receiver back for sure.
+ *
+ * Provisioning a new table: FRAME_PROGS_NUMBER 0, FRAME_PROGS_PUT
+ * up to FRAME_PROGS programs at a time, FRAME_SETTINGS_SET and
+ * FRAME_SAVE. 100 programs are 7 frames, about 0.5 s at 9600 baud.
+ */
+
+#include <util/crc16.h>
+#include "uart.h"
+#include "program.h"
+#include "frame.h"
+
+/*! waiting for FRAME_STX. */
+#define FRAME_IDLE 0
+/*! waiting for len. */
+#define FRAME_LEN 1
+/*! receiving opcode and payload. */
+#define FRAME_BODY 2
+/*! waiting for the CRC low byte. */
+#define FRAME_CRCL 3
+/*! waiting for the CRC high byte. */
+#define FRAME_CRCH 4
+
+/*! receiver state. */
+static uint8_t state;
+/*! opcode and payload. */
+static uint8_t buf[FRAME_MAX_LEN];
+/*! bytes of buf expected. */
+static uint8_t len;
+/*! bytes of buf received. */
+static uint8_t idx;
+/*! CRC of the received frame, then of the reply. */
+static uint16_t crc;
+/*! CRC received. */
+static uint16_t crc_rx;
+
+/*! \brief a frame is being received.
+ *
+ * \return TRUE if the next char belongs to the frame.
+ */
+uint8_t frame_active(void)
+{
+	return(state != FRAME_IDLE);
+}
+
+/*! send a byte of the reply. */
+static void tx(const uint8_t c)
+{
+	crc = _crc_ccitt_update(crc, c);
+	uart_putchar(0, c);
+}
+
+/*! send a 32 bit number of the reply. */
+static void tx32(const uint32_t n)
+{
+	tx(n);
+	tx(n >> 8);
+	tx(n >> 16);
+	tx(n >> 24);
+}
+
+/*! \brief start the reply.
+ *
+ * \param opcode of the request.
+ * \param status FRAME_OK or an error.
+ * \param n bytes of data after the status.
+ */
+static void tx_start(const uint8_t opcode, const uint8_t status,
+		const uint8_t n)
+{
+	uart_putchar(0, FRAME_STX);
+	crc = 0xffff;
+	tx(n + 2);
+	tx(opcode);
+	tx(status);
+}
+
+/*! end the reply with the CRC. */
+static void tx_end(void)
+{
+	uint16_t c;
+
+	c = crc;
+	uart_putchar(0, c);
+	uart_putchar(0, c >> 8);
+}
+
+/*! reply with the status only. */
+static void tx_status(const uint8_t opcode, const uint8_t status)
+{
+	tx_start(opcode, status, 0);
+	tx_end();
+}
+
+/*! \brief a program record is valid.
+ *
+ * The same ranges of the p command.
+ */
+static uint8_t prog_valid(const struct program_t *p)
+{
+	return((prog_hstart(p) < 24) && (prog_mstart(p) < 60) &&
+			(prog_dmin(p) < 1000) && !(p->rec[3] & 0x80));
+}
+
+/*! reply with the settings. */
+static void settings_get(struct programs_t *progs)
+{
+	tx_start(FRAME_SETTINGS_GET, FRAME_OK, 5);
+	tx(progs->number);
+	tx(progs->position);
+	tx(progs->valve);
+	tx(progs->flags);
+	tx(progs->lines);
+	tx_end();
+}
+
+/*! \brief set the settings.
+ *
+ * \param arg position, valve, flags and, optional, lines. Only the
+ * FL_SETTINGS bits of flags are taken, FL_ALRM stays as it is.
+ * \param n bytes of arg.
+ */
+static uint8_t settings_set(struct programs_t *progs, const uint8_t *arg,
+		const uint8_t n)
+{
+	if ((n < 3) || (n > 4) || (arg[0] > SHADOW) ||
+			((arg[1] != MONOSTABLE) && (arg[1] != BISTABLE)) ||
+			((n == 4) && (!arg[3] || (arg[3] > MAX_LINES))))
+		return(FRAME_EARG);
+
+	progs->position = arg[0];
+	progs->valve = arg[1];
+	progs->flags = (progs->flags & ~FL_SETTINGS) | (arg[2] & FL_SETTINGS);
+
+	if (n == 4)
+		progs->lines = arg[3];
+
+	store_dirty(STORE_SETTINGS);
+	return(FRAME_OK);
+}
+
+/*! \brief reply with some programs.
+ *
+ * \param arg first, count, cut to what there is.
+ * \param n bytes of arg.
+ */
+static void progs_get(struct programs_t *progs, const uint8_t *arg,
+		const uint8_t n)
+{
+	uint8_t i, j, count;
+
+	if ((n != 2) || (arg[0] > progs->number)) {
+		tx_status(FRAME_PROGS_GET, FRAME_EARG);
+		return;
+	}
+
+	count = progs->number - arg[0];
+
+	if (count > arg[1])
+		count = arg[1];
+
+	if (count > FRAME_PROGS)
+		count = FRAME_PROGS;
+
+	tx_start(FRAME_PROGS_GET, FRAME_OK, 2 + count * PROG_REC_SIZE);
+	tx(arg[0]);
+	tx(count);
+
+	for (i = arg[0]; i < arg[0] + count; i++)
+		for (j = 0; j < PROG_REC_SIZE; j++)
+			tx(progs->p[i].rec[j]);
+
+	tx_end();
+}
+
+/*! \brief write some programs.
+ *
+ * Overwrite or append, the programs after the first one must be
+ * there already, no holes.
+ *
+ * \param arg first, count, the records.
+ * \param n bytes of arg.
+ */
+static uint8_t progs_put(struct programs_t *progs, const uint8_t *arg,
+		const uint8_t n)
+{
+	struct program_t *p;
+	uint8_t i, j;
+
+	if ((n < 2) || (n != 2 + arg[1] * PROG_REC_SIZE) ||
+			(arg[0] > progs->number) ||
+			(arg[0] + arg[1] > MAX_PROGS))
+		return(FRAME_EARG);
+
+	/* all of them or none */
+	for (i = 0; i < arg[1]; i++)
+		if (!prog_valid((const struct program_t *)(arg + 2 + i * PROG_REC_SIZE)))
+			return(FRAME_EARG);
+
+	for (i = 0; i < arg[1]; i++) {
+		p = &progs->p[arg[0] + i];
+
+		for (j = 0; j < PROG_REC_SIZE; j++)
+			p->rec[j] = arg[2 + i * PROG_REC_SIZE + j];
+
+		store_dirty(arg[0] + i);
+	}
+
+	if (arg[0] + arg[1] > progs->number) {
+		progs->number = arg[0] + arg[1];
+		store_dirty(STORE_SETTINGS);
+	}
+
+	prog_sort(progs);
+	return(FRAME_OK);
+}
+
+/*! \brief cut the programs.
+ *
+ * \param arg the new number, not more than now.
+ * \param n bytes of arg.
+ */
+static uint8_t progs_number(struct programs_t *progs, const uint8_t *arg,
+		const uint8_t n)
+{
+	if ((n != 1) || (arg[0] > progs->number))
+		return(FRAME_EARG);
+
+	progs->number = arg[0];
+	store_dirty(STORE_SETTINGS);
+	prog_sort(progs);
+	return(FRAME_OK);
+}
+
+/*! \brief reply with some queue elements.
+ *
+ * In the heap order of queue.c, start, stop, line and status.
+ *
+ * \param arg first, count, cut to what there is.
+ * \param n bytes of arg.
+ */
+static void queue_get(struct programs_t *progs, const uint8_t *arg,
+		const uint8_t n)
+{
+	uint8_t i, count;
+
+	if ((n != 2) || (arg[0] > progs->qc)) {
+		tx_status(FRAME_QUEUE_GET, FRAME_EARG);
+		return;
+	}
+
+	count = progs->qc - arg[0];
+
+	if (count > arg[1])
+		count = arg[1];
+
+	if (count > FRAME_QUEUE)
+		count = FRAME_QUEUE;
+
+	tx_start(FRAME_QUEUE_GET, FRAME_OK, 2 + count * FRAME_QUEUE_SIZE);
+	tx(arg[0]);
+	tx(count);
+
+	for (i = arg[0]; i < arg[0] + count; i++) {
+		tx32(progs->q[i].start);
+		tx32(progs->q[i].stop);
+		tx(progs->q[i].oline);
+		tx(progs->q[i].status);
+	}
+
+	tx_end();
+}
+
+/*! execute a frame and reply. */
+static void frame_exec(struct programs_t *progs)
+{
+	const uint8_t *arg;
+	uint8_t n;
+
+	arg = buf + 1;
+	n = len - 1;
+
+	switch (buf[0]) {
+		case FRAME_SETTINGS_GET:
+			settings_get(progs);
+			break;
+		case FRAME_SETTINGS_SET:
+			tx_status(buf[0], settings_set(progs, arg, n));
+			break;
+		case FRAME_PROGS_GET:
+			progs_get(progs, arg, n);
+			break;
+		case FRAME_PROGS_PUT:
+			tx_status(buf[0], progs_put(progs, arg, n));
+			break;
+		case FRAME_PROGS_NUMBER:
+			tx_status(buf[0], progs_number(progs, arg, n));
+			break;
+		case FRAME_QUEUE_GET:
+			queue_get(progs, arg, n);
+			break;
+		case FRAME_SAVE:
+			prog_save(progs);
+			tx_status(buf[0], FRAME_OK);
+			break;
+		default:
+			tx_status(buf[0], FRAME_EOPCODE);
+	}
+}
+
+/*! \brief receive a char of a frame.
+ *
+ * The frame is executed when complete.
+ *
+ * \param c the char, FRAME_STX to start.
+ * \param progs
+ */
+void frame_rx(const uint8_t c, struct programs_t *progs)
+{
+	switch (state) {
+		case FRAME_IDLE:
+			if (c == FRAME_STX)
+				state = FRAME_LEN;
+
+			break;
+		case FRAME_LEN:
+			if (c && (c <= FRAME_MAX_LEN)) {
+				len = c;
+				idx = 0;
+				crc = _crc_ccitt_update(0xffff, c);
+				state = FRAME_BODY;
+			} else {
+				state = FRAME_IDLE;
+			}
+
+			break;
+		case FRAME_BODY:
+			buf[idx++] = c;
+			crc = _crc_ccitt_update(crc, c);
+
+			if (idx == len)
+				state = FRAME_CRCL;
+
+			break;
+		case FRAME_CRCL:
+			crc_rx = c;
+			state = FRAME_CRCH;
+			break;
+		default:
+			crc_rx |= (uint16_t)c << 8;
+			state = FRAME_IDLE;
+
+			if (crc_rx == crc)
+				frame_exec(progs);
+			else
+				tx_status(buf[0], FRAME_ECRC);
+	}
+}
@@ -0,0 +1,65 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file frame.h
+ * \brief Binary framed commands, see frame.c.
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "ogstruct.h"
+
+/*! first byte of a frame, never typed on the command line. */
+#define FRAME_STX 0x02
+/*! max bytes of opcode and payload. */
+#define FRAME_MAX_LEN 64
+/*! max programs in a frame, first, count and the records. */
+#define FRAME_PROGS ((FRAME_MAX_LEN - 4) / PROG_REC_SIZE)
+/*! bytes of a queue element in a frame. */
+#define FRAME_QUEUE_SIZE 10
+/*! max queue elements in a frame. */
+#define FRAME_QUEUE ((FRAME_MAX_LEN - 4) / FRAME_QUEUE_SIZE)
+
+/*! get number of programs, sun site, valve, flags and lines. */
+#define FRAME_SETTINGS_GET 0x01
+/*! set sun site, valve, flags and, optional, lines. */
+#define FRAME_SETTINGS_SET 0x02
+/*! get programs: first, count. */
+#define FRAME_PROGS_GET 0x03
+/*! put programs: first, count, records. */
+#define FRAME_PROGS_PUT 0x04
+/*! cut the programs to a number, 0 clears them. */
+#define FRAME_PROGS_NUMBER 0x05
+/*! get queue elements: first, count. */
+#define FRAME_QUEUE_GET 0x06
+/*! save the programs and the settings into the EEPROM. */
+#define FRAME_SAVE 0x07
+
+/*! reply status: done. */
+#define FRAME_OK 0
+/*! reply status: CRC mismatch, nothing done. */
+#define FRAME_ECRC 1
+/*! reply status: unknown opcode. */
+#define FRAME_EOPCODE 2
+/*! reply status: wrong payload. */
+#define FRAME_EARG 3
+
+uint8_t frame_active(void);
+void frame_rx(const uint8_t c, struct programs_t *progs);
+
+#endif
@@ -0,0 +1,46 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file host/avr/interrupt.h
+ * \brief Interrupt vectors for the host build.
+ *
+ * An ISR becomes a plain function, sim.c calls it when the
+ * simulated event happens (timer overflow, usb plug/unplug).
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+/*! Timer 2 overflow vector */
+#define TIMER2_OVF_vect __vector_timer2_ovf
+/*! External interrupt 0 vector */
+#define INT0_vect __vector_int0
+
+/*! Declare an interrupt handler. */
+#define ISR(vector) void vector(void); void vector(void)
+
+/*! global interrupt enable flag */
+extern volatile uint8_t sim_sreg_i;
+
+/*! enable interrupts */
+#define sei() (sim_sreg_i = 1)
+/*! disable interrupts */
+#define cli() (sim_sreg_i = 0)
+
+#endif
@@ -0,0 +1,127 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file host/avr/io.h
+ * \brief Simulated atmega324pa I/O registers for the host build.
+ *
+ * Every register is a plain byte in RAM (see sim.c), so the
+ * GPIO and timer drivers compile and run unmodified on the PC.
+ * Peripherals which need a real state machine behind the
+ * registers (uart and twi) are replaced at driver level.
+ */
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+/*! bit value */
+#define _BV(bit) (1 << (bit))
+/*! test a bit in a register */
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+/*! test a bit in a register */
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+/*! busy wait on a register bit */
+#define loop_until_bit_is_set(sfr, bit) do { } while (bit_is_clear(sfr, bit))
+/*! busy wait on a register bit */
+#define loop_until_bit_is_clear(sfr, bit) do { } while (bit_is_set(sfr, bit))
+
+/*! last byte of the EEPROM */
+#define E2END 0x03FF
+
+/* GPIO ports */
+extern volatile uint8_t PINA, DDRA, PORTA;
+extern volatile uint8_t PINB, DDRB, PORTB;
+extern volatile uint8_t PINC, DDRC, PORTC;
+extern volatile uint8_t PIND, DDRD, PORTD;
+
+/* External interrupts */
+extern volatile uint8_t EICRA, EIMSK;
+
+/* Timer/Counter 1 */
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+extern volatile uint16_t TCNT1;
+
+/* Timer/Counter 2 asynchronous */
+extern volatile uint8_t ASSR, TCCR2A, TCCR2B, TCNT2, TIMSK2;
+
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PC7 7
+
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+#define PIND0 0
+#define PIND1 1
+#define PIND2 2
+#define PIND3 3
+#define PIND4 4
+#define PIND5 5
+#define PIND6 6
+#define PIND7 7
+
+#define ISC00 0
+#define ISC01 1
+#define INT0 0
+
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define TOIE1 0
+
+#define TCR2BUB 0
+#define TCR2AUB 1
+#define OCR2BUB 2
+#define OCR2AUB 3
+#define TCN2UB 4
+#define AS2 5
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define TOIE2 0
+
+#endif
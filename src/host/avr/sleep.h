@@ -0,0 +1,39 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file host/avr/sleep.h
+ * \brief Sleep modes for the host build.
+ *
+ * sleep_cpu() does not sleep, it jumps straight to the next
+ * simulated wake up event (see sim_sleep()).
+ */
+
+#ifndef HOST_AVR_SLEEP_H
+#define HOST_AVR_SLEEP_H
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_PWR_SAVE 3
+
+void sim_sleep(void);
+
+#define set_sleep_mode(mode) do { } while (0)
+#define sleep_enable() do { } while (0)
+#define sleep_disable() do { } while (0)
+#define sleep_bod_disable() do { } while (0)
+#define sleep_cpu() sim_sleep()
+
+#endif
@@ -0,0 +1,39 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file avrlibc.h
+ * \brief avr-libc extensions missing from the host libc.
+ *
+ * Force-included (gcc -include) in every unit of the host build,
+ * it declares the non standard functions the firmware expects from
+ * avr-libc's stdlib.h and string.h. They are implemented in sim.c.
+ */
+
+#ifndef HOST_AVRLIBC_H
+#define HOST_AVRLIBC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+char *ultoa(unsigned long val, char *s, int radix);
+char *ltoa(long val, char *s, int radix);
+char *utoa(unsigned int val, char *s, int radix);
+char *itoa(int val, char *s, int radix);
+char *dtostrf(double val, signed char width, unsigned char prec, char *s);
+size_t strlcpy(char *dst, const char *src, size_t size);
+
+#endif
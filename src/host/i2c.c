@@ -0,0 +1,109 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file host/i2c.c
+ * \brief Simulated i2c bus with a TCN75 slave.
+ *
+ * Transactions are done when submitted, the slave has the
+ * pointer, the config and the temperature register only.
+ * The temperature comes from sim.temperature.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <util/delay.h>
+#include "../i2c.h"
+#include "../tcn75.h"
+#include "sim.h"
+
+/*! TCN75 pointer register. */
+static uint8_t tcn_ptr;
+/*! TCN75 config register. */
+static uint8_t tcn_conf;
+
+/*! transaction cost at 100KHz, 9 bit per byte. */
+static void bus_time(const uint8_t bytes)
+{
+	sim.i2c_xfer++;
+	_delay_us(90.0 * bytes);
+}
+
+/*! The TCN75 temperature register, 10 bit resolution. */
+static uint16_t tcn_temperature(void)
+{
+	return((uint16_t)(int16_t)(sim.temperature * 256.0) & 0xffc0);
+}
+
+/*! Initialize the i2c bus */
+void i2c_init(void)
+{
+}
+
+/*! Shutdown the i2c bus */
+void i2c_shut(void)
+{
+}
+
+/*! \brief queue a transaction.
+ *
+ * The bus is free at once, the transaction is done and the
+ * callback called before returning.
+ */
+void i2c_submit(struct i2c_t *xfer)
+{
+	uint8_t i;
+	uint16_t reg;
+
+	xfer->next = NULL;
+	bus_time(xfer->wlen + xfer->rlen + (xfer->wlen && xfer->rlen ? 2 : 1));
+
+	if ((xfer->addr & 0xfe) != ADDR) {
+		xfer->status = I2C_ERROR;
+	} else {
+		if (xfer->wlen)
+			tcn_ptr = xfer->wbuf[0];
+
+		if ((xfer->wlen > 1) && (tcn_ptr == 1))
+			tcn_conf = xfer->wbuf[1] & 0x7f;
+
+		if (tcn_ptr == 1)
+			reg = tcn_conf << 8;
+		else
+			reg = tcn_temperature();
+
+		for (i = 0; i < xfer->rlen; i++)
+			xfer->rbuf[i] = i ? (reg & 0xff) : (reg >> 8);
+
+		xfer->status = I2C_OK;
+	}
+
+	if (xfer->done)
+		xfer->done(xfer);
+}
+
+/*! wait for a transaction to be done. */
+uint8_t i2c_wait(struct i2c_t *xfer)
+{
+	return(xfer->status);
+}
+
+/*! submit a transaction and wait for it. */
+uint8_t i2c_xfer(struct i2c_t *xfer)
+{
+	i2c_submit(xfer);
+	return(i2c_wait(xfer));
+}
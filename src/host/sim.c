@@ -0,0 +1,290 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file host/sim.c
+ * \brief Simulated board for the host build (make host).
+ *
+ * The firmware runs unmodified on the PC, the registers are plain
+ * memory, the uart is stdin/stdout, the EEPROM is an array and the
+ * i2c bus has a TCN75 attached. The board boots with the usb cable plugged in, the
+ * commands are read from stdin and, at EOF, the cable is unplugged
+ * and the firmware goes to sleep. Any sleep jumps straight to the
+ * next timer 2 overflow, so days of scheduling run in a blink and
+ * can be profiled with perf or valgrind.
+ *
+ * Environment:
+ * - OG_SIM_WAKEUPS number of timer 2 overflow before exit.
+ * - OG_SIM_TEMP temperature read by the sensor in Celsius.
+ *
+ * \code
+ * printf "L1\np0600,010,7f,1\n" | ./opengarden_host
+ * \endcode
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include "sim.h"
+
+volatile uint8_t PINA, DDRA, PORTA;
+volatile uint8_t PINB, DDRB, PORTB;
+volatile uint8_t PINC, DDRC, PORTC;
+volatile uint8_t PIND, DDRD, PORTD;
+volatile uint8_t EICRA, EIMSK;
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+volatile uint16_t TCNT1;
+volatile uint8_t ASSR, TCCR2A, TCCR2B, TCNT2, TIMSK2;
+volatile uint8_t sim_sreg_i;
+
+struct sim_t sim;
+/*! the EEPROM of the micro. */
+static uint8_t sim_ee[E2END + 1];
+
+/* default vectors, overridden by the drivers linked in. */
+void __attribute__((weak)) __vector_timer2_ovf(void) { }
+void __attribute__((weak)) __vector_int0(void) { }
+
+/*! print the statistics at exit. */
+static void sim_report(void)
+{
+	fflush(stdout);
+	fprintf(stderr, "sim: %lu wakeups, %lu s simulated, ",
+			sim.wakeups, sim.wakeups * SIM_SEC_PER_OVF);
+	fprintf(stderr, "%.1f ms busy wait, %lu i2c transactions, ",
+			sim.delay_us / 1000.0, sim.i2c_xfer);
+	fprintf(stderr, "%lu EEPROM bytes written\n", sim.ee_writes);
+}
+
+/*! power on the board. */
+static void __attribute__((constructor)) sim_init(void)
+{
+	char *env;
+
+	sim.max_wakeups = SIM_WAKEUPS;
+	sim.temperature = SIM_TEMPERATURE;
+
+	env = getenv("OG_SIM_WAKEUPS");
+
+	if (env)
+		sim.max_wakeups = strtoul(env, NULL, 10);
+
+	env = getenv("OG_SIM_TEMP");
+
+	if (env)
+		sim.temperature = strtod(env, NULL);
+
+	/* usb cable plugged in */
+	PIND = _BV(PIND2);
+	atexit(sim_report);
+}
+
+/*! The PC has gone, unplug the usb cable. */
+void sim_usb_unplug(void)
+{
+	PIND &= ~_BV(PIND2);
+
+	if (EIMSK & _BV(INT0))
+		__vector_int0();
+}
+
+/*! Sleep until the next wake up event.
+ *
+ * The only wake up source is the timer 2 overflow, without it
+ * the micro would sleep forever and the simulation ends.
+ */
+void sim_sleep(void)
+{
+	if (!(sim_sreg_i && (TIMSK2 & _BV(TOIE2)) && (TCCR2B & 7)))
+		exit(EXIT_SUCCESS);
+
+	if (sim.wakeups >= sim.max_wakeups)
+		exit(EXIT_SUCCESS);
+
+	sim.wakeups++;
+	__vector_timer2_ovf();
+}
+
+/*! Host cycle counter.
+ *
+ * The TSC on x86, nsec elsewhere, only meaningful to compare
+ * two runs on the same PC.
+ */
+uint64_t sim_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return(__builtin_ia32_rdtsc());
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+}
+
+/*! account a busy wait. */
+void sim_delay_us(double us)
+{
+	sim.delay_us += us;
+}
+
+/*! \brief the byte of the EEPROM at addr.
+ *
+ * The addresses are the ones of the micro, see the EEPROM map in
+ * store.h, out of the EEPROM the simulation stops.
+ */
+static uint8_t *sim_ee_byte(const void *addr)
+{
+	uintptr_t a;
+
+	a = (uintptr_t)addr;
+
+	if (a > E2END) {
+		fprintf(stderr, "sim: EEPROM address %lu\n", (unsigned long)a);
+		abort();
+	}
+
+	return(&sim_ee[a]);
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+	return(*sim_ee_byte(addr));
+}
+
+uint16_t eeprom_read_word(const uint16_t *addr)
+{
+	return(eeprom_read_byte((const uint8_t *)addr) |
+			(eeprom_read_byte((const uint8_t *)addr + 1) << 8));
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		*((uint8_t *)dst + i) = eeprom_read_byte((const uint8_t *)src + i);
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value)
+{
+	*sim_ee_byte(addr) = value;
+	sim.ee_writes++;
+	sim_delay_us(SIM_EEPROM_WRITE_US);
+}
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value)
+{
+	if (eeprom_read_byte(addr) != value)
+		eeprom_write_byte(addr, value);
+}
+
+void eeprom_update_word(uint16_t *addr, uint16_t value)
+{
+	eeprom_update_byte((uint8_t *)addr, value & 0xff);
+	eeprom_update_byte((uint8_t *)addr + 1, value >> 8);
+}
+
+void eeprom_write_block(const void *src, void *dst, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		eeprom_write_byte((uint8_t *)dst + i, *((const uint8_t *)src + i));
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		eeprom_update_byte((uint8_t *)dst + i, *((const uint8_t *)src + i));
+}
+
+char *ultoa(unsigned long val, char *s, int radix)
+{
+	const char *digit = "0123456789abcdefghijklmnopqrstuvwxyz";
+	char *p, *q, c;
+
+	p = s;
+
+	do {
+		*p++ = digit[val % radix];
+		val /= radix;
+	} while (val);
+
+	*p = 0;
+
+	/* reverse */
+	for (q = s, p--; q < p; q++, p--) {
+		c = *q;
+		*q = *p;
+		*p = c;
+	}
+
+	return(s);
+}
+
+char *ltoa(long val, char *s, int radix)
+{
+	if ((val < 0) && (radix == 10)) {
+		*s = '-';
+		ultoa(-(unsigned long)val, s + 1, radix);
+	} else {
+		ultoa((unsigned long)val, s, radix);
+	}
+
+	return(s);
+}
+
+char *utoa(unsigned int val, char *s, int radix)
+{
+	return(ultoa(val, s, radix));
+}
+
+char *itoa(int val, char *s, int radix)
+{
+	return(ltoa(val, s, radix));
+}
+
+char *dtostrf(double val, signed char width, unsigned char prec, char *s)
+{
+	sprintf(s, "%*.*f", width, prec, val);
+	return(s);
+}
+
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+	size_t len;
+
+	len = strlen(src);
+
+	if (size) {
+		if (len < size) {
+			memcpy(dst, src, len + 1);
+		} else {
+			memcpy(dst, src, size - 1);
+			dst[size - 1] = 0;
+		}
+	}
+
+	return(len);
+}
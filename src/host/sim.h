@@ -0,0 +1,57 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file host/sim.h
+ * \brief Simulated board for the host build.
+ */
+
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stdint.h>
+
+/*! Simulated seconds per timer 2 overflow. */
+#define SIM_SEC_PER_OVF 8
+/*! Default number of wake up before the simulation ends (24h). */
+#define SIM_WAKEUPS 10800
+/*! Default temperature read by the simulated TCN75 */
+#define SIM_TEMPERATURE 20.0
+/*! EEPROM write time per byte in usec. */
+#define SIM_EEPROM_WRITE_US 3400
+
+/*! Statistics of the simulation. */
+struct sim_t {
+	/*! timer 2 overflow served. */
+	unsigned long wakeups;
+	/*! wake up to be served before exit. */
+	unsigned long max_wakeups;
+	/*! usec spent in _delay_ms() and _delay_us(). */
+	double delay_us;
+	/*! i2c transactions. */
+	unsigned long i2c_xfer;
+	/*! EEPROM bytes actually written. */
+	unsigned long ee_writes;
+	/*! temperature read by the tcn75 in Celsius. */
+	double temperature;
+};
+
+extern struct sim_t sim;
+
+void sim_usb_unplug(void);
+uint64_t sim_cycles(void);
+
+#endif
@@ -0,0 +1,112 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file host/uart.c
+ * \brief Simulated uart, port 0 is connected to stdin/stdout.
+ *
+ * uart_ubrr() is the one of the firmware, uart_ubrr.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "../uart.h"
+#include "sim.h"
+
+/*! baud rate of port 0 and 1, nothing to do with stdio. */
+static uint32_t baud_rate[2] = { UART_BAUD_0, UART_BAUD_1 };
+
+/*! Change the baud rate of a port. */
+void uart_baud(const uint8_t port, const uint32_t baud)
+{
+	uart_shutdown(port);
+	baud_rate[port] = baud;
+}
+
+/*! The baud rate of a port. */
+uint32_t uart_baud_get(const uint8_t port)
+{
+	return(baud_rate[port]);
+}
+
+/*! Init the uart port. */
+void uart_init(const uint8_t port)
+{
+}
+
+/*! Disable the uart port. */
+void uart_shutdown(const uint8_t port)
+{
+	fflush(stdout);
+}
+
+/*! Get a char from the uart port.
+ *
+ * At the end of the input the usb cable is unplugged.
+ */
+char uart_getchar(const uint8_t port, const uint8_t locked)
+{
+	int c;
+
+	if (port)
+		return(0);
+
+	c = getchar();
+
+	if (c == EOF) {
+		sim_usb_unplug();
+		return(0);
+	}
+
+	return(c);
+}
+
+/*! Get a byte from the uart port, 0 included.
+ *
+ * At the end of the input the usb cable is unplugged.
+ */
+uint8_t uart_rx(const uint8_t port, char *c)
+{
+	int i;
+
+	if (port)
+		return(0);
+
+	i = getchar();
+
+	if (i == EOF) {
+		sim_usb_unplug();
+		return(0);
+	}
+
+	*c = i;
+	return(1);
+}
+
+/*! Send character c down the UART Tx. */
+void uart_putchar(const uint8_t port, const char c)
+{
+	if (!port)
+		putchar(c);
+}
+
+/*! Send a C (NUL-terminated) string down the UART Tx. */
+void uart_printstr(const uint8_t port, const char *s)
+{
+	while (*s)
+		uart_putchar(port, *s++);
+}
@@ -19,50 +19,105 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <avr/io.h>
-#include <util/delay.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
 #include <util/twi.h>
 #include "i2c.h"
 
-/*! Send the i2c status to the bus.
+/*! first transaction in the queue, the one on the bus. */
+static struct i2c_t *volatile i2c_head;
+/*! last transaction in the queue. */
+static struct i2c_t *i2c_tail;
+/*! bytes written or read of the transaction on the bus. */
+static uint8_t i2c_idx;
+
+/*! START on the bus, the interrupt does the rest. */
+#define TWCR_START (_BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE))
+/*! go on with the next byte. */
+#define TWCR_NEXT (_BV(TWINT) | _BV(TWEN) | _BV(TWIE))
+
+/*! \brief end of the transaction on the bus.
  *
- * \param code the i2c code to send.
- * \param data the byte to send.
+ * STOP, and START again if another transaction is queued.
  */
-uint8_t i2c_send(const uint8_t code, const uint8_t data)
+static void i2c_end(const uint8_t status)
 {
-	switch (code) {
-		case START:
-			TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN);
-			loop_until_bit_is_set(TWCR, TWINT);
-			break;
-		case STOP:
-			TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN);
-			break;
-		case SLA:
-			TWDR = data;
-			/* clear interrupt to start transmission */
-			TWCR = _BV(TWINT) | _BV(TWEN); 
-			loop_until_bit_is_set(TWCR, TWINT);
+	struct i2c_t *xfer;
+
+	xfer = i2c_head;
+	i2c_head = xfer->next;
+	i2c_idx = 0;
+
+	if (i2c_head)
+		TWCR = TWCR_START | _BV(TWSTO);
+	else
+		TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN);
+
+	xfer->status = status;
+
+	if (xfer->done)
+		xfer->done(xfer);
+}
+
+/*! \brief the TWI state machine, one step per TWINT. */
+static void i2c_step(void)
+{
+	struct i2c_t *xfer;
+
+	xfer = i2c_head;
+
+	switch (TW_STATUS) {
+		case TW_START:
+			/* SLA+W, or SLA+R if read only */
+			if (xfer->wlen) {
+				TWDR = xfer->addr | WRITE;
+				TWCR = TWCR_NEXT;
+				break;
+			}
+
+			/* fall through */
+		case TW_REP_START:
+			i2c_idx = 0;
+			TWDR = xfer->addr | READ;
+			TWCR = TWCR_NEXT;
 			break;
-		case DATA:
-			TWDR = data;
-			/* clear interrupt to start transmission */
-			TWCR = _BV(TWINT) | _BV(TWEN); 
-			loop_until_bit_is_set(TWCR, TWINT);
+		case TW_MT_SLA_ACK:
+		case TW_MT_DATA_ACK:
+			if (i2c_idx < xfer->wlen) {
+				TWDR = xfer->wbuf[i2c_idx++];
+				TWCR = TWCR_NEXT;
+			} else if (xfer->rlen) {
+				TWCR = TWCR_START;
+			} else {
+				i2c_end(I2C_OK);
+			}
+
 			break;
-		case ACK:
-			TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWEA);
-			loop_until_bit_is_set(TWCR, TWINT);
+		case TW_MR_DATA_ACK:
+			xfer->rbuf[i2c_idx++] = TWDR;
+			/* fall through */
+		case TW_MR_SLA_ACK:
+			/* ACK all but the last byte */
+			if (i2c_idx + 1 < xfer->rlen)
+				TWCR = TWCR_NEXT | _BV(TWEA);
+			else
+				TWCR = TWCR_NEXT;
+
 			break;
-		case NACK:
-			TWCR = _BV(TWINT) | _BV(TWEN);
-			loop_until_bit_is_set(TWCR, TWINT);
+		case TW_MR_DATA_NACK:
+			xfer->rbuf[i2c_idx] = TWDR;
+			i2c_end(I2C_OK);
 			break;
 		default:
-			break;
+			/* no ack, arbitration lost or bus error */
+			i2c_end(I2C_ERROR);
 	}
+}
 
-	return(TW_STATUS);
+/*! TWI interrupt. */
+ISR(TWI_vect)
+{
+	i2c_step();
 }
 
 /*! Initialize the i2c bus */
@@ -75,132 +130,90 @@ void i2c_init(void)
 /*! Shutdown the i2c bus */
 void i2c_shut(void)
 {
-	TWSR = 0;
-	TWBR = 0;
-}
-
-/*! Send a byte to the i2c slave.
- * \param addr address of the slave.
- * \param data byte to send.
- */
-uint8_t i2c_master_send_b(const uint8_t addr, const uint8_t data)
-{
-	uint8_t err;
-
-	/* Send ADDR_W reg. 0 req. */
-	err = i2c_send(START, 0);
+	struct i2c_t *xfer;
 
-	if ((err == TW_START) || (err == TW_REP_START))
-		err = i2c_send(SLA, addr | WRITE);
+	/* the queue is completed first */
+	while ((xfer = i2c_head))
+		i2c_wait(xfer);
 
-	if (err == TW_MT_SLA_ACK)
-		err = i2c_send(DATA, data);
-
-	if (err == TW_MT_DATA_ACK)
-		err = 0;
-
-	i2c_send(STOP, 0);
-	return(err);
+	TWCR = 0;
+	TWSR = 0;
+	TWBR = 0;
 }
 
-/*! \brief i2c master send a word.
- * Send a word to the i2c slave with stop at the end.
- * \param addr address of the slave.
- * \param msb byte to send first.
- * \param lsb byte to send last.
- * \return 0 - OK, 1 - Error
+/*! \brief queue a transaction.
+ *
+ * It starts at once if the bus is free, the function does not wait.
+ *
+ * \param xfer the transaction, see struct i2c_t.
  */
-uint8_t i2c_master_send_w(const uint8_t addr, const uint8_t msb, const uint8_t lsb)
+void i2c_submit(struct i2c_t *xfer)
 {
-	uint8_t err;
-
-	/* Send ADDR_W reg. 0 req. */
-	err = i2c_send(START, 0);
-
-	if ((err == TW_START) || (err == TW_REP_START))
-		err = i2c_send(SLA, addr | WRITE);
-
-	if (err == TW_MT_SLA_ACK)
-		err = i2c_send(DATA, msb);
-
-	if (err == TW_MT_DATA_ACK)
-		err = i2c_send(DATA, lsb);
-
-	if (err == TW_MT_DATA_ACK)
-		err = 0;
+	uint8_t sreg;
+
+	xfer->status = I2C_PENDING;
+	xfer->next = NULL;
+	sreg = SREG;
+	cli();
+
+	if (i2c_head) {
+		i2c_tail->next = xfer;
+	} else {
+		i2c_head = xfer;
+		i2c_idx = 0;
+		TWCR = TWCR_START;
+	}
 
-	i2c_send(STOP, 0);
-	return(err);
+	i2c_tail = xfer;
+	SREG = sreg;
 }
 
-/*! \brief i2c master read byte.
+/*! \brief wait for a transaction to be done.
  *
- * Read a byte from the slave with a stop at the end.
+ * The cpu idles until the interrupt of the last byte, with the
+ * interrupts disabled the bus is polled. The sleep mode of the
+ * caller is restored at the end.
  *
- * \param addr address of the slave.
- * \param byte ptr to a pre-allocated byte.
- * \return 1 - value OK, 0 - Error.
+ * \param xfer a submitted transaction.
+ * \return I2C_OK or I2C_ERROR.
  */
-uint8_t i2c_master_read_b(const uint8_t addr, uint8_t *byte)
+uint8_t i2c_wait(struct i2c_t *xfer)
 {
-	uint8_t err;
-
-	err = i2c_send(START, 0);
-
-	if ((err == TW_START) || (err == TW_REP_START))
-		err = i2c_send(SLA, addr | READ);
+	uint8_t smcr;
 
-	/* send an ACK to start the TX */
-	if (err == TW_MR_SLA_ACK)
-		err = i2c_send(ACK, 0);
-
-	if (err == TW_MR_DATA_ACK) {
-		*byte = TWDR;
-		err = i2c_send(NACK, 0);
+	if (!(SREG & _BV(SREG_I))) {
+		while (xfer->status == I2C_PENDING) {
+			loop_until_bit_is_set(TWCR, TWINT);
+			i2c_step();
+		}
+	} else {
+		smcr = SMCR;
+		set_sleep_mode(SLEEP_MODE_IDLE);
+		cli();
+
+		while (xfer->status == I2C_PENDING) {
+			sleep_enable();
+			/* the sleep instruction runs before any interrupt */
+			sei();
+			sleep_cpu();
+			sleep_disable();
+			cli();
+		}
+
+		SMCR = smcr;
+		sei();
 	}
-	
-	if (err == TW_MR_DATA_NACK)
-		err = 0;
 
-	i2c_send(STOP, 0);
-	return(err);
+	return(xfer->status);
 }
-/*! Read a word (2 byte) from the slave.
+
+/*! \brief submit a transaction and wait for it.
  *
- * \param addr address of the slave.
- * \param code ptr to a pre-allocated word.
- * \return 1 - value OK, 0 - Error.
+ * \param xfer the transaction.
+ * \return I2C_OK or I2C_ERROR.
  */
-uint8_t i2c_master_read_w(const uint8_t addr, uint16_t *code)
+uint8_t i2c_xfer(struct i2c_t *xfer)
 {
-	uint8_t err;
-
-	*code = 0;
-	err = i2c_send(START, 0);
-
-	if ((err == TW_START) || (err == TW_REP_START))
-		err = i2c_send(SLA, addr | READ);
-
-	if (err == TW_MR_SLA_ACK) {
-		/* send an ACK to start the TX */
-		err = i2c_send(ACK, 0);
-	}
-
-	if (err == TW_MR_DATA_ACK) {
-		/* read the first data msb */
-		*code = (TWDR << 8);
-		err = i2c_send(ACK, 0);
-	}
-
-	if (err == TW_MR_DATA_ACK) {
-		/* read lsb */
-		*code |= TWDR;
-		err = i2c_send(NACK, 0);
-	}
-
-	if (err == TW_MR_DATA_NACK)
-		err = 0;
-
-	i2c_send(STOP, 0);
-	return(err);
+	i2c_submit(xfer);
+	return(i2c_wait(xfer));
 }
@@ -20,30 +20,48 @@
 #ifndef I2C_DEF
 #define I2C_DEF
 
-/*! define the i2c START value */
-#define START 1
-/*! define the i2c STOP value */
-#define STOP 2
-/*! define the i2c SLA value */
-#define SLA 3
-/*! define the i2c DATA value */
-#define DATA 4
-/*! define the i2c ACK value */
-#define ACK 5
-/*! define the i2c NACK value */
-#define NACK 6
-
 /*! define WRITE value */
 #define WRITE 0
 /*! define READ value */
 #define READ 1
 
-uint8_t i2c_send(const uint8_t code, const uint8_t data);
+/*! transaction waiting or on the bus */
+#define I2C_PENDING 0xff
+/*! transaction done */
+#define I2C_OK 0
+/*! no ack or bus error, the transaction has been aborted */
+#define I2C_ERROR 1
+
+/*! \brief an i2c transaction.
+ *
+ * wlen bytes are written to the slave, then, with a repeated
+ * start, rlen bytes are read, at least one of them must not be 0.
+ * The buffers and the struct must stay valid until the transaction
+ * is done.
+ */
+struct i2c_t {
+	/*! address of the slave, the R/W bit is ignored. */
+	uint8_t addr;
+	/*! bytes to write. */
+	uint8_t *wbuf;
+	/*! number of bytes to write. */
+	uint8_t wlen;
+	/*! buffer for the bytes read. */
+	uint8_t *rbuf;
+	/*! number of bytes to read. */
+	uint8_t rlen;
+	/*! I2C_PENDING, I2C_OK or I2C_ERROR. */
+	volatile uint8_t status;
+	/*! called from the interrupt when done, may be NULL. */
+	void (*done)(struct i2c_t *xfer);
+	/*! next transaction in the queue. */
+	struct i2c_t *next;
+};
+
 void i2c_init(void);
 void i2c_shut(void);
-uint8_t i2c_master_send_b(const uint8_t addr, const uint8_t data);
-uint8_t i2c_master_send_w(const uint8_t addr, const uint8_t msb, const uint8_t lsb);
-uint8_t i2c_master_read_b(const uint8_t addr, uint8_t *byte);
-uint8_t i2c_master_read_w(const uint8_t addr, uint16_t *code);
+void i2c_submit(struct i2c_t *xfer);
+uint8_t i2c_wait(struct i2c_t *xfer);
+uint8_t i2c_xfer(struct i2c_t *xfer);
 
 #endif
@@ -24,6 +24,9 @@
 #include <util/delay.h>
 #include "io_pin.h"
 
+/*! a bistable pulse has been sent since io_init(), the wake up. */
+static uint8_t pulsed;
+
 /*! send an On, Off or a pulse of PULSE_MSEC msec. on the 
  * OUT_CMD_ONOFF pin.
  */
@@ -82,6 +85,30 @@ void valve_close(const uint8_t valvetype)
 	}
 }
 
+/*! \brief a bistable pulse on an output line.
+ *
+ * The oline selects the valve, the cmd pin gives the pulse,
+ * OUT_CMD_ONOFF opens and OUT_CMD_PN closes. The pulses after the
+ * first one since the wake up wait IO_GAP_MSEC, more valves can be
+ * switched in the same wake up.
+ *
+ * \param oline the output line.
+ * \param cmd OUT_CMD_ONOFF or OUT_CMD_PN.
+ */
+static void bistable_pulse(const uint8_t oline, const uint8_t cmd)
+{
+	if (pulsed)
+		_delay_ms(IO_GAP_MSEC);
+
+	OUT_PORT = _BV(oline);
+	OUT_CMD_PORT |= _BV(cmd);
+	_delay_ms(1);
+	OUT_PORT = 0;
+	_delay_ms(PULSE_MSEC);
+	OUT_CMD_PORT &= ~_BV(cmd);
+	pulsed = TRUE;
+}
+
 /*! setup the I/O port.
  *
  * \param status I/O port status to be activated.
@@ -95,6 +122,7 @@ void io_init(void)
 	OUT_DDR = 0xff; /* all output */
 	OUT_CMD_DDR |= (_BV(OUT_CMD_ONOFF) | _BV(OUT_CMD_PN));
 	OUT_CMD_PORT &= ~(_BV(OUT_CMD_ONOFF) | _BV(OUT_CMD_PN));
+	pulsed = FALSE;
 }
 
 /*! \brief Shutdown all I/O pin.
@@ -114,59 +142,54 @@ void io_shut(void)
  * open or close the I/O line, the OUT_PORT is supposed to
  * represent the correct status of the I/O lines only if the
  * valve type is MONOSTABLE.
- * In the open case, we set the port to the corresponding oline,
- * then we also set the oline into the progs structure in order to
- * remember which ioline we are using, because this info will be lost
- * during the stand-by period. Then, after opened the valve, if the valve
- * is BISTABLE we can clear the oline from the port, no need to keep
+ * In the open case, we set the oline into the progs structure in
+ * order to remember which iolines we are using, because this info
+ * will be lost during the stand-by period. If the valve is BISTABLE
+ * the port is set to the oline for the pulse only, no need to keep
  * the line up; instead if the valve is MONOSTABLE then the PORT
- * represent the ioline in use and it must not be cleared.
+ * represent the iolines in use and it must not be cleared, the
+ * OUT_CMD_ONOFF is on while any line is.
  * In the close case and bistable valve, the port must be set to
- * the correct ioline before the close operation or it will not
- * affect any line.
+ * the oline before the close operation or it will not affect any
+ * line.
  *
  * \param oline the output line to be set.
  * \param onoff set or clear.
  * \param progs ptr to the parameters.
  * \note online is in the range 0 to 7.
- * \note no more than 1 line can be used at the same time.
- * \note if OFF, the oline param is ignored, there should be only 1 oline
- * in use to be closed.
+ * \note check with io_free() how many lines can be open.
  */
 void io_set(const uint8_t oline, const uint8_t onoff, struct programs_t *progs)
 {
 	if (onoff) {
 		/* store the ioline in use into the progs struct. */
-		progs->ioline = _BV(oline);
-		/* set the ioline to the port. */
-		OUT_PORT = _BV(oline);
+		progs->ioline |= _BV(oline);
 
 		if (progs->valve == BISTABLE) {
-			onoff_pulse(ON);
-			_delay_ms(1);
-			OUT_PORT = 0;
-			_delay_ms(PULSE_MSEC);
-			onoff_pulse(OFF);
-		} else
+			bistable_pulse(oline, OUT_CMD_ONOFF);
+		} else {
+			/* set the iolines to the port. */
+			OUT_PORT = progs->ioline;
 			valve_open(progs->valve);
+		}
 	} else {
+		progs->ioline &= ~_BV(oline);
+
 		if (progs->valve == BISTABLE) {
-			OUT_PORT = progs->ioline;
-			OUT_CMD_PORT |= _BV(OUT_CMD_PN);
-			_delay_ms(1);
-			OUT_PORT = 0;
-			_delay_ms(PULSE_MSEC);
-			OUT_CMD_PORT &= ~_BV(OUT_CMD_PN);
-		} else
-			valve_close(progs->valve);
+			bistable_pulse(oline, OUT_CMD_PN);
+		} else {
+			/* the last line closes the supply */
+			if (!progs->ioline)
+				valve_close(progs->valve);
 
-		OUT_PORT = 0;
-		progs->ioline = 0;
+			OUT_PORT = progs->ioline;
+		}
 	}
 }
 
 /*! Are there any IO out line in use?
  *
+ * \return the lines in use, one bit per line.
  */
 uint8_t io_get(struct programs_t *progs)
 {
@@ -176,14 +199,38 @@ uint8_t io_get(struct programs_t *progs)
 		return(progs->ioline);
 }
 
-/*! Close all the output line.
+/*! \brief can an output line be opened now.
  *
- * \note the oline is ignored since there must be only one oline
- * in use.
+ * Not if it is open already or if progs->lines lines are, one
+ * with bistable valves.
  */
+uint8_t io_free(const uint8_t oline, struct programs_t *progs)
+{
+	uint8_t lines, n;
+
+	if (progs->ioline & _BV(oline))
+		return(FALSE);
+
+	n = 0;
+
+	/* count the lines in use */
+	for (lines = progs->ioline; lines; lines &= lines - 1)
+		n++;
+
+	if (progs->valve == MONOSTABLE)
+		return(n < progs->lines);
+	else
+		return(!n);
+}
+
+/*! Close all the output lines. */
 void io_off(struct programs_t *progs)
 {
-	io_set(0, OFF, progs);
+	uint8_t i;
+
+	for (i = 0; i < MAX_LINES; i++)
+		if (progs->ioline & _BV(i))
+			io_set(i, OFF, progs);
 }
 
 /*! \brief get alarm status.
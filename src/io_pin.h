@@ -76,11 +76,18 @@
 #define PULSE 2
 /*! PULSE msec delay */
 #define PULSE_MSEC 50
+/*! \brief msec between two bistable pulses in the same wake up.
+ *
+ * As long as a pulse, the driver and the supply recover before
+ * the next valve is switched.
+ */
+#define IO_GAP_MSEC PULSE_MSEC
 
 void io_init(void);
 void io_shut(void);
 void io_set(const uint8_t oline, const uint8_t onoff, struct programs_t *progs);
 uint8_t io_get(struct programs_t *progs);
+uint8_t io_free(const uint8_t oline, struct programs_t *progs);
 void io_off(struct programs_t *progs);
 uint8_t io_alarm(struct programs_t *progs);
 
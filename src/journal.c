@@ -0,0 +1,240 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file journal.c
+ * \brief Journal of the events in the EEPROM.
+ *
+ * The valve open and close, the delays, the alarms and the boots
+ * are recorded with the time, the dfactor and the temperature, in a
+ * ring of JOURNAL_SIZE records in the EEPROM left by the slots of
+ * store.c, the oldest is overwritten. With MAX_PROGS 100 that is
+ * 25 records, the last dozen waterings.
+ *
+ * The records wait in RAM until there are JOURNAL_BATCH of them,
+ * then journal_flush() writes one per call from the main loop, as
+ * store_flush(). The micro stays awake for the writes once every
+ * JOURNAL_BATCH events, a reset loses the records still in RAM.
+ *
+ * The ring has no pointer to wear out, the newest record is found
+ * by sequence number at boot.
+ */
+
+#include <stddef.h>
+#include "time.h"
+#include "journal.h"
+
+/*! \brief EEPROM address of a field of a record of the ring.
+ *
+ * The ring is at JOURNAL_ADDR of the EEPROM map in store.h.
+ */
+#define EE_JOURNAL(i, field) ((uint8_t *)(JOURNAL_ADDR + \
+		(i) * JOURNAL_REC_SIZE + offsetof(struct journal_rec_t, field)))
+
+/*! records waiting to be written. */
+static struct journal_rec_t buf[JOURNAL_BATCH];
+/*! records in buf. */
+static uint8_t bufc;
+/*! records of buf already written. */
+static uint8_t sent;
+/*! the newest record in the ring. */
+static uint8_t head;
+/*! its sequence number. */
+static uint8_t seq;
+
+/*! \brief the record i of the ring has an event.
+ *
+ * The EEPROM erased is 0xff, the event 0x0f is not valid.
+ */
+static uint8_t rec_valid(const uint8_t i)
+{
+	uint8_t ev;
+
+	ev = eeprom_read_byte(EE_JOURNAL(i, event)) >> 4;
+	return((ev >= JOURNAL_BOOT) && (ev <= JOURNAL_QFULL));
+}
+
+/*! \brief find the newest record and log the boot.
+ *
+ * Call it after the time and the programs are set.
+ */
+void journal_init(struct programs_t *progs)
+{
+	uint8_t i, next, s;
+
+	bufc = 0;
+	sent = 0;
+	/* empty ring, the first write goes to 0 */
+	head = JOURNAL_SIZE - 1;
+	seq = 0xff;
+
+	for (i = 0; i < JOURNAL_SIZE; i++) {
+		if (!rec_valid(i))
+			continue;
+
+		next = (i + 1) % JOURNAL_SIZE;
+		s = eeprom_read_byte(EE_JOURNAL(i, seq));
+
+		if (!rec_valid(next) ||
+				(eeprom_read_byte(EE_JOURNAL(next, seq)) !=
+				 (uint8_t)(s + 1))) {
+			head = i;
+			seq = s;
+			break;
+		}
+	}
+
+	journal_add(progs, JOURNAL_BOOT, 0);
+}
+
+/*! \brief record an event.
+ *
+ * The time is now, the dfactor and the temperature the ones in
+ * progs. If the batch is full and not written yet, it is written
+ * now.
+ *
+ * \param progs
+ * \param event JOURNAL_BOOT...
+ * \param oline the output line, 0 if there is none.
+ */
+void journal_add(struct programs_t *progs, const uint8_t event,
+		const uint8_t oline)
+{
+	struct journal_rec_t *rec;
+	int32_t x;
+
+	if (bufc == JOURNAL_BATCH)
+		while (journal_flush(TRUE));
+
+	rec = &buf[bufc++];
+	rec->event = (event << 4) | (oline & 0x0f);
+	rec->time = gettimeofday();
+
+	x = progs->dfactor / TEMP(1.0 / JOURNAL_DF_UNIT);
+	rec->dfactor = (x < 0) ? 0 : ((x > 255) ? 255 : x);
+
+	x = progs->tnow / TEMP(1);
+	rec->temp = (x < -128) ? -128 : ((x > 127) ? 127 : x);
+}
+
+/*! \brief write the next record of a full batch.
+ *
+ * \param all write the records even if the batch is not full.
+ * \return TRUE if there is more to write.
+ */
+uint8_t journal_flush(const uint8_t all)
+{
+	struct journal_rec_t *rec;
+
+	if ((sent == bufc) || (!all && (bufc < JOURNAL_BATCH)))
+		return(FALSE);
+
+	head = (head + 1) % JOURNAL_SIZE;
+	rec = &buf[sent++];
+	rec->seq = ++seq;
+
+	/* the sequence number last */
+	eeprom_update_block(&rec->event, EE_JOURNAL(head, event),
+			sizeof(struct journal_rec_t) - 1);
+	eeprom_update_byte(EE_JOURNAL(head, seq), rec->seq);
+
+	if (sent < bufc)
+		return(TRUE);
+
+	sent = 0;
+	bufc = 0;
+	return(FALSE);
+}
+
+/*! print the name of an event. */
+static void print_event(const uint8_t event, struct debug_t *debug)
+{
+	switch (event) {
+		case JOURNAL_BOOT:
+			debug_print_P(PSTR("boot"), debug);
+			break;
+		case JOURNAL_OPEN:
+			debug_print_P(PSTR("open"), debug);
+			break;
+		case JOURNAL_CLOSE:
+			debug_print_P(PSTR("close"), debug);
+			break;
+		case JOURNAL_DELAY:
+			debug_print_P(PSTR("delay"), debug);
+			break;
+		case JOURNAL_QFULL:
+			debug_print_P(PSTR("qfull"), debug);
+			break;
+		default:
+			debug_print_P(PSTR("alarm"), debug);
+	}
+}
+
+/*! \brief print the journal, the oldest record first.
+ *
+ * The records in RAM are written first. The header is
+ * "Journal [records/JOURNAL_SIZE]", a line is
+ * " time,event,oline,dfactor,temperature".
+ */
+void journal_dump(struct debug_t *debug)
+{
+	struct journal_rec_t rec;
+	uint8_t i, n;
+
+	while (journal_flush(TRUE));
+
+	i = 0;
+
+	for (n = 0; n < JOURNAL_SIZE; n++)
+		if (rec_valid(n))
+			i++;
+
+	debug_print_P(PSTR("Journal ["), debug);
+	debug_print_num(i, 10, 2, '0', debug);
+	debug_putc('/', debug);
+	debug_print_num(JOURNAL_SIZE, 10, 2, '0', debug);
+	debug_print_P(PSTR("]\n"), debug);
+	i = head;
+
+	for (n = 0; n < JOURNAL_SIZE; n++) {
+		i = (i + 1) % JOURNAL_SIZE;
+
+		if (!rec_valid(i))
+			continue;
+
+		eeprom_read_block(&rec, EE_JOURNAL(i, seq), sizeof(rec));
+		debug_putc(' ', debug);
+		debug_print_num(rec.time, 10, 10, ' ', debug);
+		debug_putc(',', debug);
+		print_event(rec.event >> 4, debug);
+		debug_putc(',', debug);
+		debug_print_num(rec.event & 0x0f, 16, 1, ' ', debug);
+		debug_putc(',', debug);
+		debug_print_num(rec.dfactor / JOURNAL_DF_UNIT, 10, 0, ' ',
+				debug);
+		debug_putc('.', debug);
+		debug_print_num((rec.dfactor % JOURNAL_DF_UNIT) * 100 /
+				JOURNAL_DF_UNIT, 10, 2, '0', debug);
+		debug_putc(',', debug);
+
+		if (rec.temp < 0)
+			debug_putc('-', debug);
+
+		debug_print_num(rec.temp < 0 ? -rec.temp : rec.temp, 10, 0,
+				' ', debug);
+		debug_putc('\n', debug);
+	}
+}
@@ -0,0 +1,91 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file journal.h
+ * \brief Journal of the events in the EEPROM.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <avr/eeprom.h>
+#include "ogstruct.h"
+#include "debug.h"
+#include "store.h"
+
+/*! bytes of a record, struct journal_rec_t. */
+#define JOURNAL_REC_SIZE 8
+/*! records kept in RAM and written together. */
+#define JOURNAL_BATCH 4
+/*! dfactor steps per unit in a record. */
+#define JOURNAL_DF_UNIT 16
+
+#if (JOURNAL_BYTES / JOURNAL_REC_SIZE) > 128
+/*! records in the ring, 8 bit indexes and sequence. */
+#define JOURNAL_SIZE 128
+#else
+/*! \brief records in the ring, the EEPROM left by the slots.
+ *
+ * 25 with MAX_PROGS 100 in the 1 KB EEPROM, a watering is an open
+ * and a close: the last dozen waterings are kept. See the EEPROM
+ * map in store.h.
+ */
+#define JOURNAL_SIZE (JOURNAL_BYTES / JOURNAL_REC_SIZE)
+#endif
+
+#if JOURNAL_SIZE < (2 * JOURNAL_BATCH)
+#error "no EEPROM left for the journal, lower MAX_PROGS"
+#endif
+
+/*! event: the micro has been reset. */
+#define JOURNAL_BOOT 1
+/*! event: an output line opened. */
+#define JOURNAL_OPEN 2
+/*! event: an output line closed. */
+#define JOURNAL_CLOSE 3
+/*! event: a program delayed, the line is in use. */
+#define JOURNAL_DELAY 4
+/*! event: the alarm went on, the queue is emptied. */
+#define JOURNAL_ALARM 5
+/*! event: a program dropped, the queue is full. */
+#define JOURNAL_QFULL 6
+
+/*! \brief a record of the journal.
+ *
+ * The sequence number is written last, the newest record in the
+ * ring is the one not followed by the next number.
+ */
+struct journal_rec_t {
+	/*! sequence number. */
+	uint8_t seq;
+	/*! the event in the high nibble, the output line in the low. */
+	uint8_t event;
+	/*! dfactor in 1/JOURNAL_DF_UNIT, up to 255. */
+	uint8_t dfactor;
+	/*! temperature, the integer part in degree. */
+	int8_t temp;
+	/*! time of the event. */
+	uint32_t time;
+};
+
+void journal_init(struct programs_t *progs);
+void journal_add(struct programs_t *progs, const uint8_t event,
+		const uint8_t oline);
+uint8_t journal_flush(const uint8_t all);
+void journal_dump(struct debug_t *debug);
+
+#endif
@@ -39,7 +39,7 @@ void job_on_the_field(struct programs_t *progs, struct debug_t *debug, struct tm
 	if (flag_get(progs, FL_LED))
 		led_set(GREEN, ON);
 
-	if (flag_get(progs, FL_LOG)) {
+	if (LOG_ON(LOG_INFO, debug)) {
 		debug_print_P(PSTR("Executing programs at "), debug);
 		date(debug);
 	}
@@ -50,10 +50,9 @@ void job_on_the_field(struct programs_t *progs, struct debug_t *debug, struct tm
 		if (flag_get(progs, FL_LED))
 			led_set(RED, BLINK);
 
-		if (flag_get(progs, FL_LOG))
-			debug_print_P(PSTR("ALARM! queue run skipped!\n"), debug);
+		LOG_P(LOG_ERROR, debug, "ALARM! queue run skipped!\n");
 	} else {
-		if (flag_get(progs, FL_LOG)) {
+		if (LOG_ON(LOG_DEBUG, debug)) {
 			debug_print_P(PSTR("Run queue at "), debug);
 			date(debug);
 		}
@@ -64,41 +63,77 @@ void job_on_the_field(struct programs_t *progs, struct debug_t *debug, struct tm
 	/* print the temperature updated
 	 * from the prog_run call
 	 */
-	if (flag_get(progs, FL_LOG))
+	if (LOG_ON(LOG_DEBUG, debug))
 		temperature_print(progs, debug);
 
 	led_set(GREEN, OFF);
 }
 
+/*! Open and close the lines due between the changes of the minute. */
+void job_on_the_queue(struct programs_t *progs, struct debug_t *debug, struct tm *tm_clock)
+{
+	/* the queue is empty, see prog_alarm() */
+	if (flag_get(progs, FL_ALRM))
+		return;
+
+	if (LOG_ON(LOG_DEBUG, debug)) {
+		debug_print_P(PSTR("Run queue at "), debug);
+		date(debug);
+	}
+
+	queue_run(progs, tm_clock, debug);
+}
+
 /*! Sleep function.
  *
  * Which IO line is in use is recorded in the progs struct.
+ * Any RTC tick wakes the micro up, which goes back to sleep
+ * straight away until the wakeup time or the PC is connected.
+ *
+ * The ticks cannot be skipped: timer 2 is 8 bit and, on the
+ * 32768 Hz crystal with the top prescaler, overflows every 8 sec,
+ * the only clock running in power-save. The core wakes up 10800
+ * times a day whatever the wakeup time, what is saved is the work
+ * of each tick: the interrupt and the compare of this loop, about
+ * a hundred cycles, in place of restarting the peripherals and
+ * checking the programs and the queue.
  *
+ * \param valve the valve type.
+ * \param wakeup the time to wake up, 0 for the next RTC tick.
+ * \param debug
  * \note Incompatible with MONOSTABLE valve.
  */
-void go_to_sleep(uint8_t valve, struct debug_t *debug)
+void go_to_sleep(uint8_t valve, const time_t wakeup, struct debug_t *debug)
 {
 	if (valve == BISTABLE) {
-		set_sleep_mode(SLEEP_MODE_PWR_SAVE);
 		/* shut down everything */
 		i2c_shut();
 		io_shut();
 		led_shut();
+		/* after i2c_shut(), it may idle waiting for the bus */
+		set_sleep_mode(SLEEP_MODE_PWR_SAVE);
+
 		/* start sleep procedure */
-		sleep_enable();
-		sleep_bod_disable();
-		sleep_cpu();
-		sleep_disable();
+		do {
+			sleep_enable();
+			sleep_bod_disable();
+			sleep_cpu();
+			sleep_disable();
+		} while (!usb_connected && (gettimeofday() < wakeup));
+
 		/* restart everything */
 		led_init();
 		io_init();
 		i2c_init();
 	} else {
 		set_sleep_mode(SLEEP_MODE_IDLE);
+
 		/* start sleep procedure */
-		sleep_enable();
-		sleep_cpu();
-		sleep_disable();
+		do {
+			sleep_enable();
+			sleep_cpu();
+			sleep_disable();
+		} while (!usb_connected && (gettimeofday() < wakeup));
 	}
 }
 
@@ -110,6 +145,7 @@ int main(void)
 	struct cmdli_t *cmdli;
 	/* convenient pre-allocated structure */
 	struct tm *tm_clock;
+	uint8_t due;
 	char c;
 
 	/* anti warning for non initialized variables */
@@ -128,6 +164,7 @@ int main(void)
 	progs = prog_init(progs);
 	cmdli = cmdli_init(cmdli);
 	tm_clock = date_init(tm_clock, debug);
+	journal_init(progs);
         set_sleep_mode(SLEEP_MODE_PWR_SAVE);
 	sei();
 	date_hwclock_start();
@@ -147,15 +184,21 @@ int main(void)
 		 * Anyway do NOT go to sleep.
 		 */
 		if (debug->active) {
-			c = uart_getchar(0, 0);
-
-			if (c) {
-				/* echo */
-				uart_putchar(0, c);
+			/* all of it, a frame does not fit the rx buffer */
+			while (uart_rx(0, &c))
 				cmdli_exec(c, cmdli, progs, debug);
-			}
+
+			/* a record of a save or of the journal per loop */
+			if (!store_flush(progs))
+				journal_flush(FALSE);
 		} else {
-			go_to_sleep(progs->valve, debug);
+			/* the save must be completed before sleeping */
+			while (store_flush(progs));
+
+			/* and a full batch of the journal */
+			while (journal_flush(FALSE));
+
+			go_to_sleep(progs->valve, prog_wakeup(progs), debug);
 
 			if (prog_alarm(progs) && flag_get(progs, FL_LED))
 				led_set(RED, BLINK);
@@ -163,17 +206,20 @@ int main(void)
 
 		/* if there is a job to do (open, close valves).
 		 */
+		/* the queue once per tick, with the programs at the
+		 * change of the minute or alone.
+		 */
+		due = queue_due(progs, gettimeofday());
+
 		if (date_timetorun(tm_clock, debug))
 			job_on_the_field(progs, debug, tm_clock);
+		else if (due)
+			job_on_the_queue(progs, debug, tm_clock);
 	}
 
 	/* This part should never be reached */
 	date_hwclock_stop();
 	cli();
-	date_free(tm_clock);
-	cmdli_free(cmdli);
-	prog_free(progs);
-	debug_free(debug);
 
 	return(0);
 }
@@ -106,3 +106,61 @@ void flag_valve(struct programs_t *progs, const char c)
 			break;
 	}
 }
+
+/*! \brief pack a program.
+ *
+ * The fields are cut to their bits, see struct program_t.
+ *
+ * \param p the program.
+ * \param hstart start hour.
+ * \param mstart start minutes.
+ * \param dmin duration in minutes.
+ * \param dow days of the week.
+ * \param oline output line.
+ */
+void prog_set(struct program_t *p, const uint8_t hstart,
+		const uint8_t mstart, const uint16_t dmin,
+		const uint8_t dow, const uint8_t oline)
+{
+	p->rec[0] = (dow & 0x7f) | (oline << 7);
+	p->rec[1] = ((oline >> 1) & 0x03) | ((hstart & 0x1f) << 2) |
+		(mstart << 7);
+	p->rec[2] = ((mstart >> 1) & 0x1f) | (dmin << 5);
+	p->rec[3] = (dmin >> 3) & 0x7f;
+}
+
+/*! days of the week of a program. */
+uint8_t prog_dow(const struct program_t *p)
+{
+	return(p->rec[0] & 0x7f);
+}
+
+/*! output line of a program. */
+uint8_t prog_oline(const struct program_t *p)
+{
+	return((p->rec[0] >> 7) | ((p->rec[1] & 0x03) << 1));
+}
+
+/*! start hour of a program. */
+uint8_t prog_hstart(const struct program_t *p)
+{
+	return((p->rec[1] >> 2) & 0x1f);
+}
+
+/*! start minutes of a program. */
+uint8_t prog_mstart(const struct program_t *p)
+{
+	return((p->rec[1] >> 7) | ((p->rec[2] & 0x1f) << 1));
+}
+
+/*! start time of a program in minutes of the day. */
+uint16_t prog_start(const struct program_t *p)
+{
+	return(prog_hstart(p) * 60 + prog_mstart(p));
+}
+
+/*! duration of a program in minutes. */
+uint16_t prog_dmin(const struct program_t *p)
+{
+	return((p->rec[2] >> 5) | ((uint16_t)(p->rec[3] & 0x7f) << 3));
+}
@@ -22,6 +22,7 @@
 #ifndef OGSTR_H
 #define OGSTR_H
 
+#include <avr/io.h>
 #include "date.h"
 #include "debug.h"
 
@@ -35,14 +36,65 @@
  * retrival of wrong data.
  * If, during programming, you nuke the flash memory too, this check
  * code is useless.
+ * The EEPROM image no longer depends on these structs, it has its own
+ * STORE_VERSION, see store.h.
  */
-#define CHECK_VALID_CODE 0x07
-/*! \brief maximum number of programs */
-#define MAX_PROGS 20
+#define CHECK_VALID_CODE 0x09
+/*! \brief maximum number of programs.
+ *
+ * A program takes 4 bytes in RAM, 1 in the index of program.c and
+ * 4 in each EEPROM slot, see store.h. The commands address them
+ * with 2 digits, so 100 is the top. make ram_check fails the build
+ * of a micro without the RAM for them.
+ */
+#define MAX_PROGS 100
+/*! \brief maximum number of queue elements.
+ *
+ * The lines opened or waiting to be opened, not the programs. An
+ * element lives from the start of its program to the close of its
+ * line: one open and two waiting on each of the MAX_LINES lines
+ * are 24. Above PROG_MAX_FACTOR a program which does not run
+ * tomorrow adds an element which waits a day.
+ * A schedule which keeps more waiting cannot be run anyway, the
+ * program is dropped, logged and journaled, see q_push().
+ * The queue bench is built with a longer one, see BENCH_QUEUE in
+ * the Makefile.
+ */
+#ifndef MAX_QUEUE
+#define MAX_QUEUE 24
+#endif
+
+#if MAX_QUEUE > 255
+#error "the queue is indexed by uint8_t"
+#endif
+
+/*! \brief temperature and drift factor type.
+ *
+ * Fixed point Q16.16 by default, the float library is not used.
+ * Build with -D TEMP_FLOAT (see the Makefile) to go back to float.
+ * Both are 4 bytes, the struct programs_t does not change.
+ */
+#ifdef TEMP_FLOAT
+typedef float temp_t;
+/*! a constant in temp_t */
+#define TEMP(x) (x)
+#else
+typedef int32_t temp_t;
+/*! a constant in temp_t, folded by the compiler. */
+#define TEMP(x) ((temp_t)((x) * 65536.0))
+#endif
+
 /*! Maximum increment factor for time increase. */
 #define PROG_MAX_FACTOR 3.0
 /*! Factor increment for tomorrow program reschedule. */
 #define PROG_TOMORROW_FACTOR 2.0
+/*! \brief Maximum sleep in seconds between two runs.
+ *
+ * If nothing has to be done, the programs and the queue are not
+ * checked for this time. It must be less than an hour since
+ * date_timetorun() checks the minutes only.
+ */
+#define PROG_MAX_SLEEP 1800
 
 /*! queue status NEW */
 #define Q_NEW 0
@@ -65,12 +117,17 @@
 /*! valve type */
 #define BISTABLE 2
 
+/*! \brief output lines, the most that can be open at the same time.
+ *
+ * Only with monostable valves, a bistable valve is opened and closed
+ * by a pulse on the common OUT_CMD lines, one line at a time.
+ */
+#define MAX_LINES 8
+
 /*! flag sunsite 2 bit (0, 1) */
 #define FL_SUNSITE 0
 /*! flag valve type mono/bi-stable */
 #define FL_VTYPE 2
-/*! flag log enable/disable */
-#define FL_LOG 3
 /*! flag alarm level High or Low */
 #define FL_LEVEL 4
 /*! flag leds ON or OFF */
@@ -84,6 +141,9 @@
  * the main alarm.
  */
 #define FL_ALRM 6
+/*! the flags that are settings, FL_ALRM is runtime state. */
+#define FL_SETTINGS (_BV(FL_SUNSITE) | _BV(FL_SUNSITE + 1) | \
+		_BV(FL_VTYPE) | _BV(FL_LEVEL) | _BV(FL_LED))
 #define ALRM_THRESHOLD 5
 
 /*! Macro FALSE */
@@ -99,30 +159,23 @@
 /*! Macro ON */
 #define ON 1
 
-/*! A single program event structure */
-struct program_t {
-	/*! \brief Days of the week
-	 *
-	 * equal to _BV(struct tm->tm_wday)
-	 * 1 Sunday
-	 * 2 Monday
-	 * 4 Tuesday
-	 * 8 Wednesday
-	 * 16 Thursday
-	 * 32 Friday
-	 * 64 Saturday
-	 */
-	uint8_t dow;
-
-	/*! \brief Output line from 0 to 7. */
-	uint8_t oline;
+/*! bytes of a program. */
+#define PROG_REC_SIZE 4
 
-	/*! \brief start time (hours) */
-	uint8_t hstart;
-	/*! start time (minutes) */
-	uint8_t mstart;
-	/*! duration (minutes) */
-	uint16_t dmin;
+/*! \brief A single program event structure, bit packed.
+ *
+ * A 31 bit little endian record, the same in RAM and in the
+ * EEPROM, read and written with prog_set() and the prog_ getters:
+ * - bit 0-6 days of the week, equal to _BV(struct tm->tm_wday),
+ *   1 Sunday, 2 Monday, 4 Tuesday .. 64 Saturday.
+ * - bit 7-9 output line from 0 to 7.
+ * - bit 10-14 start time (hours).
+ * - bit 15-20 start time (minutes).
+ * - bit 21-30 duration (minutes) 0..1023.
+ */
+struct program_t {
+	/*! the record */
+	uint8_t rec[PROG_REC_SIZE];
 };
 
 /*! \brief the queue buffer */
@@ -135,6 +188,8 @@ struct queue_t {
 	uint8_t oline;
 	/*! the status of the queue */
 	uint8_t status;
+	/*! push order, the zones with the same start open in it */
+	uint8_t seq;
 };
 
 /*! Single structure to keep all the programs */
@@ -152,22 +207,24 @@ struct programs_t {
 	uint8_t qc;
 	/*! array of the programs 0..(MAX_PROGS - 1)*/
 	struct program_t p[MAX_PROGS];
-	/*! queue programs 0..(MAX_PROGS - 1)*/
-	struct queue_t q[MAX_PROGS];
+	/*! queue programs 0..(MAX_QUEUE - 1)*/
+	struct queue_t q[MAX_QUEUE];
 	/*! temperature realtime */
-	float tnow;
+	temp_t tnow;
 	/*! temperature media */
-	float tmedia;
+	temp_t tmedia;
 	/*! Drifting factor */
-	float dfactor;
+	temp_t dfactor;
 	/*! sunlight position */
 	uint8_t position;
 	/*! valve type */
 	uint8_t valve;
+	/*! output lines open at the same time, 1..MAX_LINES, monostable. */
+	uint8_t lines;
 	/*! see FL_ definition for this bit mapped byte flag. */
 	uint8_t flags;
-	/*! \brief I/O line in use.
-	 * In bistable valve type, we store the line in use
+	/*! \brief I/O lines in use, one bit per line.
+	 * In bistable valve type, we store the lines in use
 	 * so it can be possible to disable such line once opened
 	 * in order to close only the correct line.
 	 */
@@ -178,5 +235,14 @@ struct programs_t {
 void flag_set(struct programs_t *progs, const uint8_t bit,
 		const uint8_t val);
 uint8_t flag_get(struct programs_t *progs, const uint8_t bit);
+void prog_set(struct program_t *p, const uint8_t hstart,
+		const uint8_t mstart, const uint16_t dmin,
+		const uint8_t dow, const uint8_t oline);
+uint8_t prog_dow(const struct program_t *p);
+uint8_t prog_oline(const struct program_t *p);
+uint8_t prog_hstart(const struct program_t *p);
+uint8_t prog_mstart(const struct program_t *p);
+uint16_t prog_start(const struct program_t *p);
+uint16_t prog_dmin(const struct program_t *p);
 
 #endif
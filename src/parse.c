@@ -0,0 +1,122 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file parse.c
+ * \brief Command arguments parser.
+ *
+ * One pass over the command, in place, the numbers are checked
+ * against their range while read. It replaces the copies of the
+ * fields with strlcpy() and their conversion with strtoul() or
+ * atoi().
+ *
+ * \code {.c}
+ * parse_init(&ps, cmd + 1);
+ * hour = parse_num(&ps, 2, 10, 23);
+ * parse_sep(&ps, ',');
+ * dow = parse_num(&ps, 0, 16, 0x7f);
+ *
+ * if (!parse_end(&ps))
+ *	return(FALSE);
+ * \endcode
+ */
+
+#include "ogstruct.h"
+#include "parse.h"
+
+/*! \brief start the parse of a string.
+ *
+ * \param ps the parse.
+ * \param s the string, it is not changed.
+ */
+void parse_init(struct parse_t *ps, const char *s)
+{
+	ps->p = s;
+	ps->error = FALSE;
+}
+
+/*! \brief read an unsigned number.
+ *
+ * \param ps the parse.
+ * \param digits exactly this many digits, 0 for at least one.
+ * \param base 10 or 16, upper or lower case.
+ * \param max the largest valid value.
+ * \return the number, 0 on error.
+ */
+uint32_t parse_num(struct parse_t *ps, const uint8_t digits,
+		const uint8_t base, const uint32_t max)
+{
+	uint32_t val;
+	uint8_t n, d;
+	char c;
+
+	if (ps->error)
+		return(0);
+
+	val = 0;
+
+	for (n = 0; !digits || (n < digits); n++) {
+		c = *ps->p;
+
+		if ((c >= '0') && (c <= '9'))
+			d = c - '0';
+		else if ((base == 16) && (c >= 'a') && (c <= 'f'))
+			d = c - 'a' + 10;
+		else if ((base == 16) && (c >= 'A') && (c <= 'F'))
+			d = c - 'A' + 10;
+		else
+			break;
+
+		/* val * base + d > max, without overflow */
+		if ((d > max) || (val > (max - d) / base)) {
+			ps->error = TRUE;
+			return(0);
+		}
+
+		val = val * base + d;
+		ps->p++;
+	}
+
+	if (!n || (digits && (n < digits))) {
+		ps->error = TRUE;
+		return(0);
+	}
+
+	return(val);
+}
+
+/*! \brief skip a separator.
+ *
+ * \param ps the parse.
+ * \param c the separator expected.
+ */
+void parse_sep(struct parse_t *ps, const char c)
+{
+	if (!ps->error && (*ps->p == c))
+		ps->p++;
+	else
+		ps->error = TRUE;
+}
+
+/*! \brief the whole string has been parsed.
+ *
+ * \param ps the parse.
+ * \return TRUE if there has been no error and nothing is left.
+ */
+uint8_t parse_end(struct parse_t *ps)
+{
+	return(!ps->error && !*ps->p);
+}
@@ -0,0 +1,45 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file parse.h
+ * \brief Command arguments parser.
+ */
+
+#ifndef PARSE_H
+#define PARSE_H
+
+#include <stdint.h>
+
+/*! \brief a parse in progress.
+ *
+ * The error is sticky, after the first one the calls do nothing,
+ * so a command is parsed straight and checked once at the end.
+ */
+struct parse_t {
+	/*! next char to read. */
+	const char *p;
+	/*! TRUE after a missing or out of range field. */
+	uint8_t error;
+};
+
+void parse_init(struct parse_t *ps, const char *s);
+uint32_t parse_num(struct parse_t *ps, const uint8_t digits,
+		const uint8_t base, const uint32_t max);
+void parse_sep(struct parse_t *ps, const char c);
+uint8_t parse_end(struct parse_t *ps);
+
+#endif
@@ -25,8 +25,72 @@
 #include <string.h>
 #include "program.h"
 
-/*! global EEPROM variable */
-struct programs_t EEMEM EE_progs;
+/*! \brief programs index sorted by start time.
+ *
+ * RAM only, rebuilt with prog_sort() any time the programs change.
+ * The cursor follows the clock, it points to the first program
+ * which starts at or after the minute of the day of the last
+ * prog_run(), so the check of a minute with nothing to do is a
+ * single compare.
+ */
+static uint8_t prog_idx[MAX_PROGS];
+/*! next program in the index to be run. */
+static uint8_t prog_cursor;
+/*! minute of the day of the last check. */
+static uint16_t prog_minute;
+
+/*! start time of a program in minutes of the day. */
+static uint16_t start_minute(struct programs_t *progs, const uint8_t i)
+{
+	return(prog_start(&progs->p[i]));
+}
+
+/*! \brief rebuild the index of the programs.
+ *
+ * Insertion sort, the programs are few and usually already sorted.
+ * Programs with the same start time are kept in order.
+ */
+void prog_sort(struct programs_t *progs)
+{
+	uint8_t i, j, k;
+
+	for (i = 0; i < progs->number; i++) {
+		k = i;
+		j = i;
+
+		while (j && (start_minute(progs, prog_idx[j - 1]) > start_minute(progs, k))) {
+			prog_idx[j] = prog_idx[j - 1];
+			j--;
+		}
+
+		prog_idx[j] = k;
+	}
+
+	/* force a new seek */
+	prog_cursor = 0;
+	prog_minute = 0;
+}
+
+/*! \brief move the cursor to the first program starting at or after
+ * the given minute.
+ *
+ * \param minute of the day now.
+ * \return the cursor.
+ */
+static uint8_t prog_seek(struct programs_t *progs, const uint16_t minute)
+{
+	/* new day or clock moved back */
+	if (minute < prog_minute)
+		prog_cursor = 0;
+
+	prog_minute = minute;
+
+	while ((prog_cursor < progs->number) &&
+			(start_minute(progs, prog_idx[prog_cursor]) < minute))
+		prog_cursor++;
+
+	return(prog_cursor);
+}
 
 /*! setup program's struct to sane defaults. */
 void setup_defaults(struct programs_t *progs)
@@ -39,6 +103,7 @@ void setup_defaults(struct programs_t *progs)
 	progs->dfactor = DFACTOR_INIT;
 	progs->position = FULLSUN;
 	progs->valve = BISTABLE;
+	progs->lines = 1;
 	progs->ioline = 0;
 	/* flags setup */
 	progs->flags = FULLSUN; /* sunsite */
@@ -49,76 +114,66 @@ void setup_defaults(struct programs_t *progs)
  */
 void print_program_details(const uint8_t i, struct programs_t *progs, struct debug_t *debug)
 {
-	sprintf_P(debug->line, PSTR(" %02d,%02d%02d,%03d,%2x,%1x\n"), i, \
-			progs->p[i].hstart, progs->p[i].mstart, \
-			progs->p[i].dmin, progs->p[i].dow, \
-			progs->p[i].oline);
-	debug_print(debug);
+	struct program_t *p;
+
+	p = &progs->p[i];
+	debug_putc(' ', debug);
+	debug_print_num(i, 10, 2, '0', debug);
+	debug_putc(',', debug);
+	debug_print_num(prog_hstart(p), 10, 2, '0', debug);
+	debug_print_num(prog_mstart(p), 10, 2, '0', debug);
+	debug_putc(',', debug);
+	debug_print_num(prog_dmin(p), 10, 3, '0', debug);
+	debug_putc(',', debug);
+	debug_print_num(prog_dow(p), 16, 2, ' ', debug);
+	debug_putc(',', debug);
+	debug_print_num(prog_oline(p), 16, 1, ' ', debug);
+	debug_putc('\n', debug);
 }
 
 /*! \brief Load or re-load the programs from the eeprom.
  *
- * There are 2 case scenario, one on boot or after a reset,
- * the other after an 'C' command.
- * In the first case we do not have many valid information
- * like all the temperature informations and log status.
- * On the other case instead we have all the information
- * updated.
+ * Only the programs and the settings are in the eeprom, the
+ * temperature informations and the log status are kept.
+ * If there is nothing valid in the eeprom do some defaults.
  */
 void prog_load(struct programs_t *progs)
 {
-	float tnow, tmedia, dfact;
-	uint8_t flags;
-
-	/* keep this values after the load */
-	tnow = progs->tnow;
-	tmedia = progs->tmedia;
-	dfact = progs->dfactor;
-	flags = progs->flags;
-
-	eeprom_read_block(progs, &EE_progs, sizeof(struct programs_t));
-
-	/* initialize a new programs struct.
-	 * if the program stored in flash is not a valid
-	 * program then do some defaults.
-	 */
-	if (progs->check != CHECK_VALID_CODE) {
-		progs->check = CHECK_VALID_CODE;
+	if (!store_load(progs)) {
 		progs->number = 0; /* 0 valid program */
 		progs->position = FULLSUN;
 		progs->valve = BISTABLE;
+		progs->lines = 1;
 	}
 
 	progs->qc = 0; /* no element in the queue */
-	/* recover the valid data preserved. */
-	progs->tnow = tnow;
-	progs->tmedia = tmedia;
-	progs->dfactor = dfact;
-	progs->flags = flags;
+	prog_sort(progs);
 }
 
-/*! \brief Store the programs into the eeprom area */
+/*! \brief Store the programs into the eeprom area.
+ *
+ * Deferred, the changed records are written by store_flush().
+ */
 void prog_save(struct programs_t *progs)
 {
-	eeprom_update_block(progs, &EE_progs, sizeof(struct programs_t));
+	store_save();
 }
 
-/*! \brief initialize the program area and IO lines */
+/*! \brief initialize the program area and IO lines
+ *
+ * The programs are static, there is only one struct programs_t.
+ */
 struct programs_t *prog_init(struct programs_t *progs)
 {
-	progs = malloc(sizeof(struct programs_t));
+	static struct programs_t progs_pool;
+
+	progs = &progs_pool;
 	/* default temperature infos and log status. */
 	setup_defaults(progs);
+	store_init();
 	return(progs);
 }
 
-/*! Free the allocated memory and close the IO lines */
-void prog_free(struct programs_t *progs)
-{
-	/*! \todo shut IO down, to be implemented but useless. */
-	free(progs);
-}
-
 /*! Check which program to exec.
  * \param progs
  * \param tm_clock time now.
@@ -126,35 +181,128 @@ void prog_free(struct programs_t *progs)
  */
 void prog_run(struct programs_t *progs, struct tm *tm_clock, struct debug_t *debug)
 {
-	uint8_t i;
+	uint8_t i, j;
+	uint16_t minute;
 	time_t tnow;
 
 	tnow = mktime(tm_clock);
-	/* update temperature and dfactor */
-	temperature_update(progs);
+	/* sample the temperature if it is time to */
+	temperature_update(progs, tnow);
+
+	minute = tm_clock->tm_hour * 60 + tm_clock->tm_min;
 
 	/* remember you must not change the temperature or dfactor */
-	for (i=0; i<progs->number; i++) {
-		if ((progs->p[i].dow & _BV(tm_clock->tm_wday)) &&
-				(progs->p[i].hstart == tm_clock->tm_hour) &&
-				(progs->p[i].mstart == tm_clock->tm_min)) {
+	for (i = prog_seek(progs, minute); (i < progs->number) &&
+			(start_minute(progs, prog_idx[i]) == minute); i++) {
+		j = prog_idx[i];
+
+		if (prog_dow(&progs->p[j]) & _BV(tm_clock->tm_wday)) {
+			/* dfactor with the samples in the batch */
+			temperature_fold(progs);
+
+			if (LOG_ON(LOG_INFO, debug))
+				print_program_details(j, progs, debug);
 
-			if (flag_get(progs, FL_LOG))
-				print_program_details(i, progs, debug);
+			if (!q_push(progs, tm_clock, j))
+				LOG_P(LOG_ERROR, debug,
+						"queue full, program dropped!\n");
 
-			q_push(progs, tm_clock, i);
 			tm_clock = gmtime(&tnow);
 		}
 	}
 }
 
+/*! \brief when the next program starts.
+ *
+ * Walk the index from now on, up to the same time next week.
+ *
+ * \param progs
+ * \param tm_clock time now.
+ * \return the start time of the next program, 0 if there is none.
+ */
+time_t prog_next(struct programs_t *progs, struct tm *tm_clock)
+{
+	uint8_t i, d, wday;
+	uint16_t minute;
+	time_t today;
+
+	minute = tm_clock->tm_hour * 60 + tm_clock->tm_min;
+	/* midnight of today */
+	today = mktime(tm_clock) - minute * 60UL - tm_clock->tm_sec;
+	wday = tm_clock->tm_wday;
+
+	for (d = 0; d < 8; d++) {
+		for (i = 0; i < progs->number; i++) {
+			/* today only after now */
+			if (!d && (start_minute(progs, prog_idx[i]) <= minute))
+				continue;
+
+			if (prog_dow(&progs->p[prog_idx[i]]) & _BV(wday))
+				return(today + start_minute(progs, prog_idx[i]) * 60UL);
+		}
+
+		today += 86400UL;
+
+		if (++wday > 6)
+			wday = 0;
+	}
+
+	return(0);
+}
+
+/*! \brief when the programs and the queue must be checked again.
+ *
+ * The earliest between the next program start, the next temperature
+ * sample and PROG_MAX_SLEEP from now, rounded up to the minute since
+ * they are checked at the change of the minute, and the next queue
+ * element to open or to close, to the second, see queue_due().
+ *
+ * \param progs
+ * \return the time to wake up, 0 to wake up at the next RTC tick.
+ * \note with a line in use the alarm must be checked at every tick.
+ */
+time_t prog_wakeup(struct programs_t *progs)
+{
+	time_t now, wakeup, t;
+
+	if (io_get(progs))
+		return(0);
+
+	now = gettimeofday();
+	wakeup = now + PROG_MAX_SLEEP;
+	t = prog_next(progs, gmtime_now());
+
+	if (t && (t < wakeup))
+		wakeup = t;
+
+	t = temperature_next();
+
+	if (t && (t < wakeup))
+		wakeup = t;
+
+	/* not before the next minute */
+	if (wakeup < now + 60 - (now % 60))
+		wakeup = now + 60 - (now % 60);
+
+	if (wakeup % 60)
+		wakeup += 60 - (wakeup % 60);
+
+	t = queue_next(progs);
+
+	if (t && (t < wakeup))
+		wakeup = t;
+
+	return(wakeup);
+}
+
 /*! list all valid programs */
 void prog_list(struct programs_t *progs, struct debug_t *debug)
 {
 	uint8_t i;
 
-	sprintf_P(debug->line, PSTR("Programs [%02d]\n"), progs->number);
-	debug_print(debug);
+	debug_print_P(PSTR("Programs ["), debug);
+	debug_print_num(progs->number, 10, 2, '0', debug);
+	debug_print_P(PSTR("]\n"), debug);
 
 	for (i = 0; i < progs->number; i++)
 		print_program_details(i, progs, debug);
@@ -164,44 +312,49 @@ void prog_list(struct programs_t *progs, struct debug_t *debug)
 void prog_clear(struct programs_t *progs)
 {
 	progs->number = 0;
+	store_dirty(STORE_SETTINGS);
+	prog_sort(progs);
 }
 
 /*! add a program into memory
  *
  * \param progs ptr to programs.
- * \param s string in the form pShSm,shsm,DD,OO
+ * \param s string in the form pShSm,dtime,DD,OL
  * where:
- * Sh Start hour in the form 0..24.
- * Sm Start minutes.
- * sh Stop hour.
- * sm Stop minutes.
- * DD Day of the week sun..sat bit for day (HEX number).
- * OO output line 0..7 bit for line 0 to 7 (HEX number).
+ * Sh Start hour 0..23.
+ * Sm Start minutes 0..59.
+ * dtime duration in minutes 0..999.
+ * DD Day of the week sun..sat bit for day (HEX number 0..7F).
+ * OL output line 0..7.
+ * \return FALSE if the string is not valid or the programs are full.
  */
-void prog_add(struct programs_t *progs, const char *s)
-{
-	char *substr;
-
-	if (progs->number + 1 < MAX_PROGS) {
-		substr = malloc(3);
-		/* get Sh, copy from s char 1..2 into substr */
-		strlcpy(substr, s + 1, 3);
-		progs->p[progs->number].hstart = strtoul(substr, 0, 10);
-		/* get Sm, copy from s char 3..4 into substr */
-		strlcpy(substr, s + 3, 3);
-		progs->p[progs->number].mstart = strtoul(substr, 0, 10);
-		/* get duration */
-		strlcpy(substr, s + 6, 4);
-		progs->p[progs->number].dmin = strtoul(substr, 0, 10);
-		/* get DD */
-		strlcpy(substr, s + 10, 3);
-		progs->p[progs->number].dow = strtoul(substr, 0, 16);
-		/* get OL */
-		strlcpy(substr, s + 13, 2);
-		progs->p[progs->number].oline = strtoul(substr, 0, 10);
-		free(substr);
+uint8_t prog_add(struct programs_t *progs, const char *s)
+{
+	struct parse_t ps;
+	uint8_t hstart, mstart, dow, oline;
+	uint16_t dmin;
+
+	parse_init(&ps, s + 1);
+	hstart = parse_num(&ps, 2, 10, 23);
+	mstart = parse_num(&ps, 2, 10, 59);
+	parse_sep(&ps, ',');
+	dmin = parse_num(&ps, 0, 10, 999);
+	parse_sep(&ps, ',');
+	dow = parse_num(&ps, 0, 16, 0x7f);
+	parse_sep(&ps, ',');
+	oline = parse_num(&ps, 1, 10, 7);
+
+	if (parse_end(&ps) && (progs->number < MAX_PROGS)) {
+		prog_set(&progs->p[progs->number], hstart, mstart, dmin,
+				dow, oline);
+		store_dirty(progs->number);
+		store_dirty(STORE_SETTINGS);
 		progs->number++;
+		prog_sort(progs);
+		return(TRUE);
 	}
+
+	return(FALSE);
 }
 
 /*! \brief remove a program from the memory */
@@ -210,10 +363,14 @@ uint8_t prog_del(struct programs_t *progs, const uint8_t n)
 	uint8_t i;
 
 	if (n < progs->number) {
-		for (i=n+1; i < progs->number; i++)
+		for (i=n+1; i < progs->number; i++) {
 			progs->p[i-1] = progs->p[i];
+			store_dirty(i-1);
+		}
 
+		store_dirty(STORE_SETTINGS);
 		progs->number--;
+		prog_sort(progs);
 		return(1);
 	} else {
 		return(0);
@@ -230,6 +387,9 @@ uint8_t prog_alarm(struct programs_t *progs)
 
 	if (io_alarm(progs)) {
 		if (counter > ALRM_THRESHOLD) {
+			if (!flag_get(progs, FL_ALRM))
+				journal_add(progs, JOURNAL_ALARM, 0);
+
 			flag_set(progs, FL_ALRM, TRUE);
 			io_off(progs); /* close the line in use */
 			progs->qc = 0; /* remove all progs in the queue */
@@ -29,16 +29,21 @@
 #include "date.h"
 #include "temperature.h"
 #include "queue.h"
+#include "store.h"
+#include "journal.h"
+#include "parse.h"
 
 struct programs_t *prog_init(struct programs_t *progs);
-void prog_free(struct programs_t *progs);
 void prog_load(struct programs_t *progs);
 void prog_save(struct programs_t *progs);
 void prog_list(struct programs_t *progs, struct debug_t *debug);
 void prog_clear(struct programs_t *progs);
-void prog_add(struct programs_t *progs, const char *s);
+void prog_sort(struct programs_t *progs);
+uint8_t prog_add(struct programs_t *progs, const char *s);
 uint8_t prog_del(struct programs_t *progs, const uint8_t n);
 void prog_run(struct programs_t *progs, struct tm *tm_clock, struct debug_t *debug);
 uint8_t prog_alarm(struct programs_t *progs);
+time_t prog_next(struct programs_t *progs, struct tm *tm_clock);
+time_t prog_wakeup(struct programs_t *progs);
 
 #endif
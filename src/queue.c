@@ -27,13 +27,12 @@
 
 /*! print the status of a queue element.
  *
- * \param progs
  * \param debug
- * \param index the indexed element of the queue.
+ * \param status Q_NEW, Q_OFF...
  */
-void print_qstatus(struct programs_t *progs, struct debug_t *debug, const uint8_t index)
+static void print_qstatus(struct debug_t *debug, const uint8_t status)
 {
-	switch (progs->q[index].status) {
+	switch (status) {
 		case Q_NEW:
 			debug_print_P(PSTR("new"), debug);
 			break;
@@ -52,30 +51,162 @@ void print_qstatus(struct programs_t *progs, struct debug_t *debug, const uint8_
 }
 
 /*! print a single queue line.
+ *
+ * \param progs
+ * \param debug
+ * \param index the indexed element of the queue.
+ * \param status to be printed, not the one of the element.
  */
-void print_qline(struct programs_t *progs, struct debug_t *debug, const uint8_t index)
+static void print_qline(struct programs_t *progs, struct debug_t *debug,
+		const uint8_t index, const uint8_t status)
 {
-	if (flag_get(progs, FL_LOG)) {
-		sprintf_P(debug->line, PSTR(" %10lu,%10lu,%1x,"), \
-				progs->q[index].start, \
-				progs->q[index].stop, \
-				progs->q[index].oline);
-		debug_print(debug);
-		print_qstatus(progs, debug, index);
-		debug_print_P(PSTR(" -> "), debug);
+	debug_putc(' ', debug);
+	debug_print_num(progs->q[index].start, 10, 10, ' ', debug);
+	debug_putc(',', debug);
+	debug_print_num(progs->q[index].stop, 10, 10, ' ', debug);
+	debug_putc(',', debug);
+	debug_print_num(progs->q[index].oline, 16, 1, ' ', debug);
+	debug_putc(',', debug);
+	print_qstatus(debug, status);
+}
+
+/*! \brief when an element of the queue needs attention.
+ *
+ * The queue is a binary min-heap on this key: the start of a
+ * waiting element, the stop of a running one.
+ */
+static time_t q_key(struct programs_t *progs, const uint8_t i)
+{
+	if (progs->q[i].status == Q_RUN)
+		return(progs->q[i].stop);
+	else
+		return(progs->q[i].start);
+}
+
+/*! \brief element i opens before element j.
+ *
+ * The earlier start, the first pushed with the same start. The
+ * push order wraps, it holds among the programs of the same minute.
+ */
+static uint8_t q_before(struct programs_t *progs, const uint8_t i,
+		const uint8_t j)
+{
+	if (progs->q[i].start != progs->q[j].start)
+		return(progs->q[i].start < progs->q[j].start);
+	else
+		return((int8_t)(progs->q[i].seq - progs->q[j].seq) < 0);
+}
+
+/*! swap two elements of the queue. */
+static void q_swap(struct programs_t *progs, const uint8_t i, const uint8_t j)
+{
+	struct queue_t tmp;
+
+	tmp = progs->q[i];
+	progs->q[i] = progs->q[j];
+	progs->q[j] = tmp;
+}
+
+/*! move up an element until its parent is not later. */
+static void q_sift_up(struct programs_t *progs, uint8_t i)
+{
+	uint8_t parent;
+
+	while (i) {
+		parent = (i - 1) >> 1;
+
+		if (q_key(progs, parent) <= q_key(progs, i))
+			break;
+
+		q_swap(progs, i, parent);
+		i = parent;
 	}
 }
 
+/*! move down an element until its children are not earlier. */
+static void q_sift_down(struct programs_t *progs, uint8_t i)
+{
+	uint8_t child;
+
+	/* i has a child, 2i + 1 does not overflow */
+	while (i < (progs->qc >> 1)) {
+		child = (i << 1) + 1;
+
+		if ((child + 1 < progs->qc) &&
+				(q_key(progs, child + 1) < q_key(progs, child)))
+			child++;
+
+		if (q_key(progs, i) <= q_key(progs, child))
+			break;
+
+		q_swap(progs, i, child);
+		i = child;
+	}
+}
+
+/*! \brief add an element to the queue.
+ *
+ * \param progs
+ * \param start time to open the line.
+ * \param stop time to close the line.
+ * \param oline the output line.
+ * \return FALSE if the queue is full, the element is dropped and
+ * journaled.
+ */
+static uint8_t q_insert(struct programs_t *progs, const time_t start,
+		const time_t stop, const uint8_t oline)
+{
+	static uint8_t seq;
+
+	if (progs->qc >= MAX_QUEUE) {
+		journal_add(progs, JOURNAL_QFULL, oline);
+		return(FALSE);
+	}
+
+	progs->q[progs->qc].start = start;
+	progs->q[progs->qc].stop = stop;
+	progs->q[progs->qc].oline = oline;
+	progs->q[progs->qc].status = Q_NEW;
+	progs->q[progs->qc].seq = seq++;
+	progs->qc++;
+	q_sift_up(progs, progs->qc - 1);
+	return(TRUE);
+}
+
+/*! \brief the duration of a program in seconds.
+ *
+ * \param dmin the duration in minutes.
+ * \param factor the increment factor, 0..PROG_MAX_FACTOR.
+ * \note in fixed point the seconds times the integer and the
+ * fraction of the factor are taken apart, both fit in 32 bit and
+ * the duration is truncated as the float one, see test_temp.c.
+ */
+static time_t q_duration(const uint16_t dmin, const temp_t factor)
+{
+#ifdef TEMP_FLOAT
+	return((unsigned long int)(dmin * 60.0 * factor));
+#else
+	uint32_t sec;
+
+	sec = (uint32_t)dmin * 60;
+	return(sec * ((uint32_t)factor >> 16) +
+			((sec * ((uint32_t)factor & 0xffff)) >> 16));
+#endif
+}
+
 /*! \brief queue a program to be executed.
  * \param progs the programs struct.
  * \param tm_clock the time.
  * \param i the program number to be pushed into the queue.
+ * \return FALSE if the queue is full and the program is dropped.
  */
-void q_push(struct programs_t *progs, struct tm *tm_clock, const uint8_t i)
+uint8_t q_push(struct programs_t *progs, struct tm *tm_clock, const uint8_t i)
 {
 	time_t tnow, tend;
-	uint8_t tomorrow;
-	float dfactor;
+	uint8_t tomorrow, ok;
+	temp_t dfactor;
+
+	ok = TRUE;
 
 	/* now in seconds */
 	tnow = mktime(tm_clock);
@@ -90,8 +221,8 @@ void q_push(struct programs_t *progs, struct tm *tm_clock, const uint8_t i)
 	 * else apply drift factor and store the new
 	 * end of the program.
 	 */
-	if (dfactor > PROG_MAX_FACTOR) {
-		dfactor = PROG_MAX_FACTOR;
+	if (dfactor > TEMP(PROG_MAX_FACTOR)) {
+		dfactor = TEMP(PROG_MAX_FACTOR);
 		/* set tomorrow */
 		tomorrow = _BV(tm_clock->tm_wday) << 1;
 
@@ -100,54 +231,51 @@ void q_push(struct programs_t *progs, struct tm *tm_clock, const uint8_t i)
 			tomorrow = 1;
 
 		/* if the program does not run tomorrow */
-		if (!(progs->p[i].dow & tomorrow)) {
-			tend = tnow + (unsigned long int)(progs->p[i].dmin * 60.0 * PROG_TOMORROW_FACTOR);
-
-			if (progs->qc < (MAX_PROGS - 1)) {
-				progs->q[progs->qc].start = tnow + 86400l;
-				progs->q[progs->qc].stop = tend + 86400l;
-				progs->q[progs->qc].oline = progs->p[i].oline;
-				progs->q[progs->qc].status = Q_NEW;
-				progs->qc++;
-			}
+		if (!(prog_dow(&progs->p[i]) & tomorrow)) {
+			tend = tnow + q_duration(prog_dmin(&progs->p[i]), TEMP(PROG_TOMORROW_FACTOR));
+			ok = q_insert(progs, tnow + 86400l, tend + 86400l,
+					prog_oline(&progs->p[i]));
 		}
 	}
 
 	if (dfactor > 0) {
-		tend = tnow + (unsigned long int)(progs->p[i].dmin * 60.0 * dfactor);
-
-		if (progs->qc < (MAX_PROGS - 1)) {
-			progs->q[progs->qc].start = tnow;
-			progs->q[progs->qc].stop = tend;
-			progs->q[progs->qc].oline = progs->p[i].oline;
-			progs->q[progs->qc].status = Q_NEW;
-			progs->qc++;
-		}
+		tend = tnow + q_duration(prog_dmin(&progs->p[i]), dfactor);
+		ok &= q_insert(progs, tnow, tend, prog_oline(&progs->p[i]));
 	}
+
+	return(ok);
 }
 
-/*! \brief pop the next program from the queue */
+/*! \brief remove an element from the queue.
+ *
+ * The last element takes its place and goes up or down the heap.
+ */
 void q_pop(struct programs_t *progs, const uint8_t i)
 {
-	uint8_t j;
-
-	for (j=i+1; j<progs->qc; j++)
-		progs->q[j-1] = progs->q[j];
-
 	progs->qc--;
+
+	if (i < progs->qc) {
+		progs->q[i] = progs->q[progs->qc];
+		q_sift_down(progs, i);
+		q_sift_up(progs, i);
+	}
 }
 
-/*! Remove Q_OFF element from the queue.
+/*! \brief next element of the heap walked in preorder, skipping
+ * the children of i.
+ *
+ * \return the index, progs->qc at the end of the walk.
  */
-void q_purge(struct programs_t *progs)
+static uint8_t q_skip(struct programs_t *progs, uint8_t i)
 {
-	uint8_t i = 0;
-
-	while (i<progs->qc)
-		if (progs->q[i].status == Q_OFF)
-			q_pop(progs, i);
-		else
-			i++;
+	/* up while i is a right child or the last one */
+	while (i && (!(i & 1) || (i + 1 >= progs->qc)))
+		i = (i - 1) >> 1;
+
+	if (i)
+		return(i + 1);
+	else
+		return(progs->qc);
 }
 
 /*! Open the oline of the indexed queue element.
@@ -168,70 +296,175 @@ void run(struct programs_t *progs, const time_t tnow, const uint8_t index)
 	io_set(progs->q[index].oline, ON, progs);
 }
 
-/*! Check which program in the queue to exec.
+/*! \brief journal and log the change of status of an element.
+ *
  * \param progs
- * \param tm_clock time now.
+ * \param i the element.
+ * \param status the status before.
  * \param debug
- * \bug With bistable valve opening and closing oline cannot be done at the same time, any io-action must be done on separate queue-run.
- * \note the printed infos rappresent the status of a queue before.
  */
-void queue_run(struct programs_t *progs, struct tm *tm_clock, struct debug_t *debug)
+static void q_changed(struct programs_t *progs, const uint8_t i,
+		const uint8_t status, struct debug_t *debug)
 {
-	uint8_t i, exit;
-	time_t tnow;
+	switch (progs->q[i].status) {
+		case Q_RUN:
+			journal_add(progs, JOURNAL_OPEN, progs->q[i].oline);
+			break;
+		case Q_OFF:
+			journal_add(progs, JOURNAL_CLOSE, progs->q[i].oline);
+			break;
+		case Q_DELAYED:
+			journal_add(progs, JOURNAL_DELAY, progs->q[i].oline);
+			break;
+	}
+
+	if (LOG_ON(LOG_DEBUG, debug)) {
+		print_qline(progs, debug, i, status);
+		debug_print_P(PSTR(" -> "), debug);
+		print_qstatus(debug, progs->q[i].status);
+		debug_print_P(PSTR("\n"), debug);
+	}
+}
+
+/*! \brief walk the due elements, close or open one.
+ *
+ * Only the elements due are visited, the heap is walked in
+ * preorder and the subtree of an element not due yet is skipped,
+ * nothing is due if the first element is not.
+ * Closing, the first running element found is closed. Opening,
+ * the preorder is not the time order: a new element which cannot
+ * be opened is delayed, of the ones which can the first by
+ * q_before() is opened at the end of the walk.
+ *
+ * \param progs
+ * \param tnow the time.
+ * \param close close the running elements, else open the waiting
+ * ones.
+ * \param debug
+ * \return the element changed, its heap position has to be fixed,
+ * progs->qc if there is none.
+ */
+static uint8_t q_pass(struct programs_t *progs, const time_t tnow,
+		const uint8_t close, struct debug_t *debug)
+{
+	uint8_t i, next, status;
 
-	tnow = mktime(tm_clock);
 	i = 0;
-	exit = FALSE;
-
-	while ((i<progs->qc) && (exit == FALSE)) {
-		print_qline(progs, debug, i);
-
-		if (progs->q[i].start <= tnow) {
-			switch (progs->q[i].status) {
-				case Q_NEW:
-					if (io_get(progs)) {
-						progs->q[i].status = Q_DELAYED;
-					} else {
-						run(progs, tnow, i);
-						/* force exit */
-						exit = TRUE;
-					}
-
-					break;
-				case Q_RUN:
-					if (progs->q[i].stop <= tnow) {
-						progs->q[i].status = Q_OFF;
-						io_set(progs->q[i].oline, OFF, progs);
-						/* force exit */
-						exit = TRUE;
-					}
-
-					break;
-				case Q_DELAYED:
-					if (!io_get(progs)) {
-						run(progs, tnow, i);
-						/* force exit */
-						exit = TRUE;
-					}
-
-					break;
-				case Q_OFF:
-				default:
-					break;
-			}
+	next = progs->qc;
+
+	while (i < progs->qc) {
+		if (q_key(progs, i) > tnow) {
+			i = q_skip(progs, i);
+			continue;
+		}
+
+		status = progs->q[i].status;
+
+		if (close && (status == Q_RUN)) {
+			progs->q[i].status = Q_OFF;
+			io_set(progs->q[i].oline, OFF, progs);
+			q_changed(progs, i, status, debug);
+			return(i);
 		}
 
-		if (flag_get(progs, FL_LOG)) {
-			print_qstatus(progs, debug, i);
-			debug_print_P(PSTR("\n"), debug);
+		if (!close && ((status == Q_NEW) || (status == Q_DELAYED))) {
+			if (!io_free(progs->q[i].oline, progs)) {
+				if (status == Q_NEW) {
+					progs->q[i].status = Q_DELAYED;
+					q_changed(progs, i, status, debug);
+				}
+			} else if ((next == progs->qc) ||
+					q_before(progs, i, next)) {
+				next = i;
+			}
 		}
 
-		i++;
+		if ((i << 1) + 1 < progs->qc)
+			i = (i << 1) + 1;
+		else
+			i = q_skip(progs, i);
+	}
+
+	if (next < progs->qc) {
+		status = progs->q[next].status;
+		run(progs, tnow, next);
+		q_changed(progs, next, status, debug);
 	}
 
-	/* purge all Q_OFF elements */
-	q_purge(progs);
+	return(next);
+}
+
+/*! \brief close and open the elements due.
+ *
+ * All the lines due are closed first, then all the lines due which
+ * can be are opened, in the same pass. A zone which follows
+ * another one on the same line, or with bistable valves, starts
+ * when the other stops, io_set() spaces the pulses.
+ *
+ * \param progs
+ * \param tnow the time.
+ * \param debug
+ */
+static void q_run(struct programs_t *progs, const time_t tnow,
+		struct debug_t *debug)
+{
+	uint8_t i;
+
+	/* closed, out of the queue */
+	while ((i = q_pass(progs, tnow, TRUE, debug)) < progs->qc)
+		q_pop(progs, i);
+
+	/* opened, waiting for the stop */
+	while ((i = q_pass(progs, tnow, FALSE, debug)) < progs->qc)
+		q_sift_down(progs, i);
+}
+
+/*! Check which program in the queue to exec, see q_run().
+ *
+ * \param progs
+ * \param tm_clock time now.
+ * \param debug
+ * \note the printed infos rappresent the status of a queue before.
+ */
+void queue_run(struct programs_t *progs, struct tm *tm_clock, struct debug_t *debug)
+{
+	q_run(progs, mktime(tm_clock), debug);
+}
+
+/*! \brief a queue element has to be opened or closed now.
+ *
+ * The queue is run at the change of the minute with the programs
+ * and, in between, at the first RTC tick at or after the start or
+ * the stop of an element, so a line closes within a tick of its
+ * stop. Once per tick, the delayed elements stay due until a line
+ * is free.
+ *
+ * \param progs
+ * \param tnow the time.
+ */
+uint8_t queue_due(struct programs_t *progs, const time_t tnow)
+{
+	static time_t last;
+
+	if (!progs->qc || (q_key(progs, 0) > tnow) || (tnow == last))
+		return(FALSE);
+
+	last = tnow;
+	return(TRUE);
+}
+
+/*! \brief next time something changes in the queue.
+ *
+ * \param progs
+ * \return the earliest start of a waiting element or stop of a
+ * running one, 0 if the queue is empty.
+ */
+time_t queue_next(struct programs_t *progs)
+{
+	if (progs->qc)
+		return(q_key(progs, 0));
+	else
+		return(0);
 }
 
 /*! list all valid programs */
@@ -239,11 +472,12 @@ void queue_list(struct programs_t *progs, struct debug_t *debug)
 {
 	uint8_t i;
 
-	sprintf_P(debug->line, PSTR("Queue [%02d]\n"), progs->qc);
-	debug_print(debug);
+	debug_print_P(PSTR("Queue ["), debug);
+	debug_print_num(progs->qc, 10, 2, '0', debug);
+	debug_print_P(PSTR("]\n"), debug);
 
 	for (i = 0; i < progs->qc; i++) {
-		print_qline(progs, debug, i);
+		print_qline(progs, debug, i, progs->q[i].status);
 		debug_print_P(PSTR("\n"), debug);
 	}
 }
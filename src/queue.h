@@ -27,8 +27,10 @@
 #include "date.h"
 #include "temperature.h"
 
-void q_push(struct programs_t *progs, struct tm *tm_clock, const uint8_t i);
+uint8_t q_push(struct programs_t *progs, struct tm *tm_clock, const uint8_t i);
 void queue_run(struct programs_t *progs, struct tm *tm_clock, struct debug_t *debug);
 void queue_list(struct programs_t *progs, struct debug_t *debug);
+uint8_t queue_due(struct programs_t *progs, const time_t tnow);
+time_t queue_next(struct programs_t *progs);
 
 #endif
@@ -28,6 +28,8 @@
 
 /*!
   IRQ wakes up on the timer oveflow and increment the global seconds.
+  With the prescaler at 1024 the 8 bit timer overflows every 8 sec,
+  the longest the micro can sleep, see go_to_sleep().
  */
 ISR(TIMER2_OVF_vect)
 {
@@ -0,0 +1,343 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file store.c
+ * \brief Programs and settings in the EEPROM.
+ *
+ * A save marks every record dirty, a change to a program or to the
+ * settings marks its record dirty again. The writes are deferred, store_flush() does one record per call from the main
+ * loop, so a save does not stall the command line for the ~3.4 ms
+ * per byte of the EEPROM. It is completed before sleeping and
+ * before a load only.
+ *
+ * The image has STORE_SLOTS copies, the newest valid one by
+ * sequence number is in use. Every save writes the whole image to
+ * the next slot, the CRC and the header last, the slot in use is
+ * not touched. A slot is valid if the CRC of its content matches,
+ * so an interrupted save falls back to the image of the save
+ * before. Only the bytes that differ are written, the next slot is
+ * STORE_SLOTS - 1 saves old.
+ *
+ * The image of the older releases, and the one of STORE_VERSION 1,
+ * are converted on the first load.
+ */
+
+#include <stddef.h>
+#include <util/crc16.h>
+#include "store.h"
+
+/*! the slots, at STORE_ADDR of the EEPROM map in store.h. */
+#define EE_slots ((struct store_slot_t *)STORE_ADDR)
+
+/*! dirty records, one bit per program plus STORE_SETTINGS. */
+static uint8_t dirty[(MAX_PROGS + 8) / 8];
+/*! slot in use. */
+static uint8_t slot;
+/*! its sequence number. */
+static uint8_t seq;
+/*! slot the save goes to. */
+static uint8_t target;
+/*! a save is in progress. */
+static uint8_t pending;
+/*! a valid slot has been found. */
+static uint8_t valid;
+
+/*! \brief CRC of the settings of a slot. */
+static uint16_t crc_settings(const uint8_t number, const uint8_t position,
+		const uint8_t valve)
+{
+	uint16_t crc;
+
+	crc = _crc_ccitt_update(0xffff, number);
+	crc = _crc_ccitt_update(crc, position);
+	return(_crc_ccitt_update(crc, valve));
+}
+
+/*! \brief is a slot complete and not corrupted.
+ *
+ * A single pass over what the CRC covers.
+ */
+static uint8_t slot_valid(const uint8_t i)
+{
+	struct store_head_t head;
+	uint16_t crc;
+	uint8_t *ee;
+	uint16_t j;
+
+	eeprom_read_block(&head, &EE_slots[i].head, sizeof(head));
+
+	if ((head.magic != STORE_MAGIC) || (head.version != STORE_VERSION) ||
+			(head.number > MAX_PROGS))
+		return(FALSE);
+
+	crc = crc_settings(head.number, head.position, head.valve);
+	crc = _crc_ccitt_update(crc, head.lines);
+	ee = EE_slots[i].p[0].rec;
+
+	for (j = 0; j < head.number * PROG_REC_SIZE; j++)
+		crc = _crc_ccitt_update(crc, eeprom_read_byte(ee + j));
+
+	return(crc == head.crc);
+}
+
+/*! \brief find the slot in use.
+ *
+ * Without any valid slot, the first save writes slot 0.
+ */
+void store_init(void)
+{
+	uint8_t i, s;
+
+	valid = FALSE;
+	slot = STORE_SLOTS - 1;
+	seq = 0xff;
+
+	for (i = 0; i < STORE_SLOTS; i++) {
+		if (!slot_valid(i))
+			continue;
+
+		s = eeprom_read_byte(&EE_slots[i].head.seq);
+
+		/* newer, the sequence wraps */
+		if (!valid || ((int8_t)(s - seq) > 0)) {
+			valid = TRUE;
+			slot = i;
+			seq = s;
+		}
+	}
+
+	pending = FALSE;
+}
+
+/*! \brief mark a record as changed.
+ *
+ * \param rec the program number or STORE_SETTINGS.
+ */
+void store_dirty(const uint8_t rec)
+{
+	dirty[rec >> 3] |= _BV(rec & 7);
+}
+
+/*! \brief load the image of the releases before the versioned one.
+ *
+ * It is converted with a save, which starts at once.
+ *
+ * \return TRUE if there is one.
+ */
+static uint8_t load_legacy(struct programs_t *progs)
+{
+	uint8_t *ee, i;
+
+	/* the old image was at the start of the EEPROM, as the slots now */
+	ee = (uint8_t *)EE_slots;
+
+	if ((eeprom_read_byte(ee) != STORE_LEGACY_CHECK) ||
+			(eeprom_read_byte(ee + STORE_LEGACY_NUMBER) > MAX_PROGS))
+		return(FALSE);
+
+	progs->number = eeprom_read_byte(ee + STORE_LEGACY_NUMBER);
+	progs->position = eeprom_read_byte(ee + STORE_LEGACY_POSITION);
+	progs->valve = eeprom_read_byte(ee + STORE_LEGACY_POSITION + 1);
+	progs->lines = 1;
+
+	/* the legacy struct program_t, byte by byte */
+	for (i = 0; i < progs->number; i++) {
+		ee = (uint8_t *)EE_slots + STORE_LEGACY_PROGS + i * 6;
+		prog_set(&progs->p[i], eeprom_read_byte(ee + 2),
+				eeprom_read_byte(ee + 3),
+				eeprom_read_byte(ee + 4) |
+				(eeprom_read_byte(ee + 5) << 8),
+				eeprom_read_byte(ee), eeprom_read_byte(ee + 1));
+	}
+
+	store_save();
+	return(TRUE);
+}
+
+/*! \brief load the image of STORE_VERSION 1, without lines.
+ *
+ * Version 1 has been written with 20 and with 100 programs, both
+ * strides are looked for, as many slots as fit in the EEPROM. The
+ * first slot is the same in both. The newest valid slot is
+ * converted with a save, which starts at once.
+ *
+ * \return TRUE if there is one.
+ */
+static uint8_t load_v1(struct programs_t *progs)
+{
+	const uint16_t size[] = { STORE_V1_SLOT_SIZE(20),
+		STORE_V1_SLOT_SIZE(100) };
+	struct store_v1_head_t head;
+	uint8_t *base;
+	uint16_t crc, j;
+	uint8_t i, k, n, found, s;
+
+	found = FALSE;
+	s = 0;
+
+	for (k = 0; k < sizeof(size) / sizeof(size[0]); k++) {
+		n = (size[k] - STORE_V1_HEAD_SIZE) / PROG_REC_SIZE;
+
+		for (i = 0; (i < 4) && ((i + 1) * size[k] <= E2END + 1); i++) {
+			base = (uint8_t *)EE_slots + i * size[k];
+			eeprom_read_block(&head, base, STORE_V1_HEAD_SIZE);
+
+			if ((head.magic != STORE_MAGIC) || (head.version != 1) ||
+					(head.number > n))
+				continue;
+
+			crc = crc_settings(head.number, head.position,
+					head.valve);
+
+			for (j = 0; j < head.number * PROG_REC_SIZE; j++)
+				crc = _crc_ccitt_update(crc, eeprom_read_byte(
+						base + STORE_V1_HEAD_SIZE + j));
+
+			/* not valid or older, the sequence wraps */
+			if ((crc != head.crc) ||
+					(found && ((int8_t)(head.seq - s) <= 0)))
+				continue;
+
+			found = TRUE;
+			s = head.seq;
+			progs->number = head.number;
+			progs->position = head.position;
+			progs->valve = head.valve;
+			eeprom_read_block(progs->p, base + STORE_V1_HEAD_SIZE,
+					head.number * PROG_REC_SIZE);
+		}
+	}
+
+	if (found) {
+		progs->lines = 1;
+		store_save();
+	}
+
+	return(found);
+}
+
+/*! \brief load the programs and the settings.
+ *
+ * A save in progress is completed first.
+ *
+ * \param progs
+ * \return TRUE if loaded, FALSE if the EEPROM is empty.
+ */
+uint8_t store_load(struct programs_t *progs)
+{
+	uint8_t i;
+
+	while (store_flush(progs));
+
+	if (!valid)
+		return(load_v1(progs) || load_legacy(progs));
+
+	progs->number = eeprom_read_byte(&EE_slots[slot].head.number);
+	progs->position = eeprom_read_byte(&EE_slots[slot].head.position);
+	progs->valve = eeprom_read_byte(&EE_slots[slot].head.valve);
+	progs->lines = eeprom_read_byte(&EE_slots[slot].head.lines);
+
+	eeprom_read_block(progs->p, EE_slots[slot].p,
+			progs->number * PROG_REC_SIZE);
+
+	for (i = 0; i < sizeof(dirty); i++)
+		dirty[i] = 0;
+
+	return(TRUE);
+}
+
+/*! \brief save the changes.
+ *
+ * The records are written by store_flush() to the next slot, all of
+ * them, the slot is behind by the saves in between. The commands do
+ * not wait for a save in progress, what they change is marked dirty
+ * and written again before the end, the CRC is taken from RAM.
+ */
+void store_save(void)
+{
+	uint8_t i;
+
+	if (pending)
+		return;
+
+	target = (slot + 1) % STORE_SLOTS;
+
+	for (i = 0; i <= STORE_SETTINGS; i++)
+		store_dirty(i);
+
+	pending = TRUE;
+}
+
+/*! \brief write the next dirty record of a save.
+ *
+ * When they are all written the CRC follows, then the sequence
+ * number that makes the slot the newest and the magic last. Until
+ * the CRC matches, the slot in use is the one before.
+ *
+ * \param progs
+ * \return TRUE if there is more to write.
+ */
+uint8_t store_flush(struct programs_t *progs)
+{
+	uint16_t crc;
+	uint8_t i, j;
+
+	if (!pending)
+		return(FALSE);
+
+	for (i = 0; i <= STORE_SETTINGS; i++)
+		if (dirty[i >> 3] & _BV(i & 7)) {
+			dirty[i >> 3] &= ~_BV(i & 7);
+
+			if (i == STORE_SETTINGS) {
+				eeprom_update_byte(&EE_slots[target].head.number, progs->number);
+				eeprom_update_byte(&EE_slots[target].head.position, progs->position);
+				eeprom_update_byte(&EE_slots[target].head.valve, progs->valve);
+				eeprom_update_byte(&EE_slots[target].head.lines, progs->lines);
+				return(TRUE);
+			}
+
+			/* deleted programs are not written */
+			if (i < progs->number) {
+				eeprom_update_block(&progs->p[i],
+						&EE_slots[target].p[i],
+						PROG_REC_SIZE);
+				return(TRUE);
+			}
+		}
+
+	crc = crc_settings(progs->number, progs->position, progs->valve);
+	crc = _crc_ccitt_update(crc, progs->lines);
+
+	for (i = 0; i < progs->number; i++)
+		for (j = 0; j < PROG_REC_SIZE; j++)
+			crc = _crc_ccitt_update(crc, progs->p[i].rec[j]);
+
+	eeprom_update_word(&EE_slots[target].head.crc, crc);
+
+	/* the new slot is complete, make it the newest */
+	slot = target;
+	seq++;
+	eeprom_update_byte(&EE_slots[slot].head.saves, 0);
+	eeprom_update_byte(&EE_slots[slot].head.seq, seq);
+	eeprom_update_byte(&EE_slots[slot].head.version, STORE_VERSION);
+	eeprom_update_byte(&EE_slots[slot].head.magic, STORE_MAGIC);
+	valid = TRUE;
+	pending = FALSE;
+
+	return(FALSE);
+}
@@ -0,0 +1,175 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file store.h
+ * \brief Programs and settings in the EEPROM.
+ */
+
+#ifndef STORE_H
+#define STORE_H
+
+#include <avr/eeprom.h>
+#include "ogstruct.h"
+
+/*! bytes of the header of a slot, struct store_head_t. */
+#define STORE_HEAD_SIZE 10
+/*! bytes of a slot. */
+#define STORE_SLOT_SIZE (STORE_HEAD_SIZE + MAX_PROGS * PROG_REC_SIZE)
+
+#if (E2END + 1) >= (4 * STORE_SLOT_SIZE)
+/*! \brief number of copies of the image in the EEPROM.
+ *
+ * Every save goes to the next slot, the wear is spread over all
+ * the slots and the one in use is never written.
+ */
+#define STORE_SLOTS 4
+#else
+/*! number of copies of the image, the EEPROM is too small for 4. */
+#define STORE_SLOTS 2
+#endif
+
+/*! \brief the EEPROM map, everything in the EEPROM is placed here.
+ *
+ * The slots at STORE_ADDR, 0, where the older releases had the
+ * image, see load_legacy(). The journal of journal.c from
+ * JOURNAL_ADDR to the end, JOURNAL_BYTES.
+ */
+#define STORE_ADDR 0
+/*! first byte of the journal, after the slots. */
+#define JOURNAL_ADDR (STORE_ADDR + STORE_SLOTS * STORE_SLOT_SIZE)
+/*! bytes of the journal. */
+#define JOURNAL_BYTES ((E2END + 1) - JOURNAL_ADDR)
+
+#if (E2END + 1) < JOURNAL_ADDR
+#error "MAX_PROGS too big for the EEPROM"
+#endif
+
+#if STORE_ADDR != 0
+#error "the legacy and the STORE_VERSION 1 images are read at 0"
+#endif
+
+/*! the settings record: number of programs, sun site, valve and lines. */
+#define STORE_SETTINGS MAX_PROGS
+
+/*! first byte of a slot. */
+#define STORE_MAGIC 0x4f
+/*! \brief format of the image.
+ *
+ * Change it any time the slot or the record layout changes, and
+ * read the old one in store_load(). MAX_PROGS sets the size of a
+ * slot, so it changes the layout too:
+ * - 1, 20 programs, 4 slots of STORE_V1_SLOT_SIZE(20).
+ * - 1, 100 programs, 2 slots of STORE_V1_SLOT_SIZE(100), the size
+ *   changed without a new version.
+ * - 2, 100 programs, lines in the header.
+ */
+#define STORE_VERSION 2
+/*! the programs in a slot of STORE_VERSION 2. */
+#define STORE_VERSION_PROGS 100
+
+#if MAX_PROGS != STORE_VERSION_PROGS
+#error "MAX_PROGS changes the slot, change STORE_VERSION"
+#endif
+
+/*! \brief check code of the image of the releases before the
+ * versioned format, the raw struct programs_t at address 0.
+ */
+#define STORE_LEGACY_CHECK 0x07
+/*! offset of the number of programs in the legacy image. */
+#define STORE_LEGACY_NUMBER 1
+/*! offset of the programs in the legacy image. */
+#define STORE_LEGACY_PROGS 3
+/*! offset of the sun site in the legacy image, the valve follows. */
+#define STORE_LEGACY_POSITION 335
+
+/*! \brief header of a slot.
+ *
+ * The CRC covers number, position, valve, lines and the first
+ * number records, what the slot has to say. The sequence number and the
+ * save counter are bookkeeping.
+ */
+struct store_head_t {
+	/*! STORE_MAGIC if the slot has been written. */
+	uint8_t magic;
+	/*! STORE_VERSION. */
+	uint8_t version;
+	/*! sequence number, the newest valid slot is the one in use. */
+	uint8_t seq;
+	/*! always 0, the saves in place of STORE_VERSION 1. */
+	uint8_t saves;
+	/*! CRC-CCITT, see above. */
+	uint16_t crc;
+	/*! number of valid programs. */
+	uint8_t number;
+	/*! sunlight position. */
+	uint8_t position;
+	/*! valve type. */
+	uint8_t valve;
+	/*! output lines open at the same time. */
+	uint8_t lines;
+};
+
+/*! bytes of the header of a STORE_VERSION 1 slot, without lines. */
+#define STORE_V1_HEAD_SIZE 9
+/*! bytes of a STORE_VERSION 1 slot of n programs. */
+#define STORE_V1_SLOT_SIZE(n) (STORE_V1_HEAD_SIZE + (n) * PROG_REC_SIZE)
+
+/*! \brief header of a slot of the STORE_VERSION 1 image.
+ *
+ * As the header above without lines, the CRC covers number,
+ * position, valve and the records. The records follow at
+ * STORE_V1_HEAD_SIZE, the struct is padded on the host.
+ */
+struct store_v1_head_t {
+	/*! STORE_MAGIC. */
+	uint8_t magic;
+	/*! 1. */
+	uint8_t version;
+	/*! sequence number. */
+	uint8_t seq;
+	/*! saves in place. */
+	uint8_t saves;
+	/*! CRC-CCITT. */
+	uint16_t crc;
+	/*! number of valid programs. */
+	uint8_t number;
+	/*! sunlight position. */
+	uint8_t position;
+	/*! valve type. */
+	uint8_t valve;
+};
+
+/*! \brief the image in the EEPROM.
+ *
+ * Only what survives a reboot, the queue and the temperature
+ * are not saved.
+ * The programs are kept as they are in RAM, see struct program_t.
+ */
+struct store_slot_t {
+	/*! the header. */
+	struct store_head_t head;
+	/*! the programs. */
+	struct program_t p[MAX_PROGS];
+};
+
+void store_init(void);
+void store_dirty(const uint8_t rec);
+uint8_t store_load(struct programs_t *progs);
+void store_save(void);
+uint8_t store_flush(struct programs_t *progs);
+
+#endif
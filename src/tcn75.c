@@ -21,6 +21,11 @@
  * PC1 SDA
  * PC2 IN ALLERT
  * PC3 - 5 ADDRESS
+ *
+ * The periodic sample runs in the background with i2c_submit(), the
+ * bus at its speed takes hundreds of msec for it: tcn75_convert()
+ * starts a conversion and tcn75_sample() reads it, at a later
+ * wakeup. The config at boot still waits with i2c_xfer().
  */
 
 #include <stdlib.h>
@@ -29,65 +34,180 @@
 #include <util/delay.h>
 #include "tcn75.h"
 
+/*! \brief write the pointer register, and more, then read.
+ *
+ * \param wbuf pointer register and data to write.
+ * \param wlen bytes to write.
+ * \param rbuf buffer for the data read.
+ * \param rlen bytes to read, 0 for none.
+ * \return 0 - OK, 1 - Error.
+ */
+static uint8_t tcn75_xfer(uint8_t *wbuf, const uint8_t wlen,
+		uint8_t *rbuf, const uint8_t rlen)
+{
+	struct i2c_t xfer;
+
+	xfer.addr = ADDR;
+	xfer.wbuf = wbuf;
+	xfer.wlen = wlen;
+	xfer.rbuf = rbuf;
+	xfer.rlen = rlen;
+	xfer.done = NULL;
+
+	return(i2c_xfer(&xfer));
+}
+
+/*! the read of the temperature register of tcn75_sample(). */
+static struct i2c_t tcn_read;
+/*! the start of a conversion of tcn75_convert(). */
+static struct i2c_t tcn_conv;
+/*! the last of the two submitted, NULL for none. */
+static struct i2c_t *tcn_last;
+/*! pointer register of the read. */
+static uint8_t tcn_rptr;
+/*! temperature register read. */
+static uint8_t tcn_code[2];
+/*! pointer and config register written to start the conversion. */
+static uint8_t tcn_cbuf[2];
+/*! where the temperature read goes. */
+static volatile int16_t *tcn_dst;
+
+/*! the read is done, from the interrupt. */
+static void sample_done(struct i2c_t *xfer)
+{
+	if (xfer->status == I2C_OK)
+		*tcn_dst = (int16_t)(((uint16_t)tcn_code[0] << 8) |
+				tcn_code[1]);
+	else
+		*tcn_dst = TCN_ERROR;
+}
+
 /*! write config register. */
 uint8_t tcn75_write_config_reg(const uint8_t cfg)
 {
-	if (i2c_master_send_w(ADDR, 1, cfg))
-		return(1);
-	else
-		return(0);
+	uint8_t buf[2];
+
+	buf[0] = 1;
+	buf[1] = cfg;
+
+	return(tcn75_xfer(buf, 2, NULL, 0));
 }
 
 /*! read config register. */
 uint8_t tcn75_read_config_reg(uint8_t *reg)
 {
-	if (i2c_master_send_b(ADDR, 1))
-		return(1);
-	else
-		if (i2c_master_read_b(ADDR, reg))
-			return(2);
+	uint8_t ptr;
+
+	ptr = 1;
 
-	return(0);
+	return(tcn75_xfer(&ptr, 1, reg, 1));
 }
 
-/*! \brief take a temperature sample.
- * \bug should check the config register after the
- * delay to see if the sample has been taken.
+/*! \brief start a temperature conversion.
+ *
+ * The result is ready after TCN_TSAMPLE msec, then the sensor goes
+ * back to shutdown and keeps it until the next conversion.
+ *
+ * \return 0 - OK, 1 - Error.
  */
-void tcn75_one_shot(void)
+uint8_t tcn75_start(void)
 {
-	tcn75_write_config_reg(TCN_CONF | 0x80);
-	_delay_ms(TCN_TSAMPLE);
+	return(tcn75_write_config_reg(TCN_CONF | 0x80));
 }
 
-/*! Initialize tcn75 */
-void tcn75_init(void)
+/*! \brief read the result of the last conversion.
+ *
+ * \return the temperature register as it is, Celsius in Q8.8,
+ * TCN_ERROR on error.
+ */
+int16_t tcn75_collect(void)
 {
-	i2c_init();
-	tcn75_write_config_reg(TCN_CONF);
+	uint8_t ptr, code[2];
+
+	ptr = 0;
+
+	if (tcn75_xfer(&ptr, 1, code, 2))
+		return(TCN_ERROR);
+
+	/* casting uint16 to int16 */
+	return((int16_t)(((uint16_t)code[0] << 8) | code[1]));
 }
 
-/*! read the temperature and return it in a float
+/*! \brief start a conversion, in the background.
+ *
+ * The config write is queued on the bus, the function does not
+ * wait. The result is ready after TCN_TSAMPLE msec, see
+ * tcn75_sample().
  */
-float tcn75_read_temperature(void)
+void tcn75_convert(void)
 {
-	uint16_t code;
-	float temp;
+	tcn75_wait();
+	tcn_cbuf[0] = 1;
+	tcn_cbuf[1] = TCN_CONF | 0x80;
+	tcn_conv.addr = ADDR;
+	tcn_conv.wbuf = tcn_cbuf;
+	tcn_conv.wlen = 2;
+	tcn_conv.rbuf = NULL;
+	tcn_conv.rlen = 0;
+	tcn_conv.done = NULL;
+	tcn_last = &tcn_conv;
+	i2c_submit(&tcn_conv);
+}
 
-	temp = -99;
+/*! \brief read the last conversion, in the background.
+ *
+ * The read is queued on the bus, the function does not wait. The
+ * temperature, Celsius in Q8.8 or TCN_ERROR, is stored in *t from
+ * the interrupt, see tcn75_wait().
+ *
+ * \param t where the temperature goes, it must stay valid.
+ */
+void tcn75_sample(volatile int16_t *t)
+{
+	tcn75_wait();
+	tcn_dst = t;
+	tcn_rptr = 0;
+	tcn_read.addr = ADDR;
+	tcn_read.wbuf = &tcn_rptr;
+	tcn_read.wlen = 1;
+	tcn_read.rbuf = tcn_code;
+	tcn_read.rlen = 2;
+	tcn_read.done = sample_done;
+	tcn_last = &tcn_read;
+	i2c_submit(&tcn_read);
+}
 
-	tcn75_one_shot();
+/*! \brief wait for the last tcn75_convert() or tcn75_sample().
+ *
+ * \return 0 - done or nothing submitted, 1 - Error.
+ */
+uint8_t tcn75_wait(void)
+{
+	if (tcn_last)
+		return(i2c_wait(tcn_last));
+	else
+		return(0);
+}
 
-	if (i2c_master_send_b(ADDR, 0)) {
-		/* error */
-	} else {
-		if (i2c_master_read_w(ADDR, &code)) {
-			/* Error */
-		} else {
-			/* casting uint16 to int16 */
-			temp = (int16_t)code / 256.0;
-		}
-	}
+/*! Initialize tcn75 */
+void tcn75_init(void)
+{
+	i2c_init();
+	tcn75_write_config_reg(TCN_CONF);
+}
 
-	return(temp);
+/*! \brief read the temperature now.
+ *
+ * Start a conversion and wait for it.
+ *
+ * \return the temperature register as it is, Celsius in Q8.8,
+ * TCN_ERROR on error.
+ * \bug should check the config register after the
+ * delay to see if the sample has been taken.
+ */
+int16_t tcn75_read_temperature(void)
+{
+	tcn75_start();
+	_delay_ms(TCN_TSAMPLE);
+	return(tcn75_collect());
 }
@@ -33,9 +33,16 @@
  * Depend on the resolution setting.
  */
 #define TCN_TSAMPLE 250
+/*! temperature returned on error, -99 Celsius. */
+#define TCN_ERROR (-99 * 256)
 
 void tcn75_init(void);
 uint8_t tcn75_read_config_reg(uint8_t *reg);
-float tcn75_read_temperature(void);
+uint8_t tcn75_start(void);
+int16_t tcn75_collect(void);
+int16_t tcn75_read_temperature(void);
+void tcn75_convert(void);
+void tcn75_sample(volatile int16_t *t);
+uint8_t tcn75_wait(void);
 
 #endif
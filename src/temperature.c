@@ -19,14 +19,80 @@
   */
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
 #include "temperature.h"
 
-/*! \brief update the temperature and the media */
-void temperature_update(struct programs_t *progs)
+#ifndef TEMP_FLOAT
+/*! \brief one minute of the fixed point media.
+ *
+ * media += (tnow - media) * TMEDIA_WSING, the difference is taken
+ * in Q8.8 to keep the product in 32 bit and the step is rounded,
+ * or the media drifts down.
+ */
+static temp_t tmedia_step(const temp_t tmedia, const temp_t tnow)
+{
+	return(tmedia + ((((tnow - tmedia) >> 8) * TMEDIA_WSING_Q24 + 0x8000) >> 16));
+}
+
+/*! \brief the fixed point drift factor.
+ *
+ * (tmedia - base) / ratio + 1, as a multiply by 1/ratio in Q0.16
+ * of the difference in Q8.8.
+ */
+static temp_t dfactor_calc(const temp_t tmedia, const temp_t base,
+		const int32_t ratio_inv)
+{
+	return((((tmedia - base) >> 8) * ratio_inv >> 8) + TEMP(1));
+}
+#endif
+
+/*! samples not yet in the media, Celsius in Q8.8, the last one
+ * may be on the bus, see tcn75_sample().
+ */
+static volatile int16_t batch_sample[TEMP_BATCH];
+/*! minutes each sample stands for. */
+static uint8_t batch_minutes[TEMP_BATCH];
+/*! number of samples in the batch. */
+static uint8_t batch_n;
+/*! when the next sample is due. */
+static time_t sample_next;
+
+/*! \brief fold the samples into the media and update the dfactor.
+ *
+ * The media weights are for a sample per minute, a sample is taken
+ * as the temperature of all the minutes since the one before.
+ *
+ * \param progs the programs struct.
+ */
+void temperature_fold(struct programs_t *progs)
 {
-	progs->tnow = tcn75_read_temperature();
-	progs->tmedia = (progs->tmedia * TMEDIA_WALL) + (progs->tnow * TMEDIA_WSING);
+	uint8_t i, minutes;
 
+	/* the last sample read */
+	tcn75_wait();
+
+	for (i = 0; i < batch_n; i++) {
+		minutes = batch_minutes[i];
+#ifdef TEMP_FLOAT
+		progs->tnow = batch_sample[i] / 256.0;
+
+		if (minutes == 1)
+			progs->tmedia = (progs->tmedia * TMEDIA_WALL) + (progs->tnow * TMEDIA_WSING);
+		else
+			progs->tmedia = progs->tnow + (progs->tmedia - progs->tnow) * pow(TMEDIA_WALL, minutes);
+#else
+		/* Q8.8 to Q16.16 */
+		progs->tnow = (temp_t)batch_sample[i] * 256;
+
+		while (minutes--)
+			progs->tmedia = tmedia_step(progs->tmedia, progs->tnow);
+#endif
+	}
+
+	batch_n = 0;
+
+#ifdef TEMP_FLOAT
 	switch (progs->position) {
 		case FULLSUN:
 			progs->dfactor = (progs->tmedia - TMEDIA_BASE_FS)/TMEDIA_RATIO_FS + 1.0;
@@ -38,24 +104,129 @@ void temperature_update(struct programs_t *progs)
 			progs->dfactor = (progs->tmedia - TMEDIA_BASE_SW)/TMEDIA_RATIO_SW + 1.0;
 			break;
 	}
+#else
+	switch (progs->position) {
+		case FULLSUN:
+			progs->dfactor = dfactor_calc(progs->tmedia,
+					TEMP(TMEDIA_BASE_FS),
+					(int32_t)(65536.0 / TMEDIA_RATIO_FS));
+			break;
+		case HALFSUN:
+			progs->dfactor = dfactor_calc(progs->tmedia,
+					TEMP(TMEDIA_BASE_HS),
+					(int32_t)(65536.0 / TMEDIA_RATIO_HS));
+			break;
+		default:
+			progs->dfactor = dfactor_calc(progs->tmedia,
+					TEMP(TMEDIA_BASE_SW),
+					(int32_t)(65536.0 / TMEDIA_RATIO_SW));
+			break;
+	}
+#endif
+}
+
+/*! \brief sample the temperature if it is time to.
+ *
+ * One sample every TEMP_SAMPLE_PERIOD, whatever the programs do.
+ * The samples are kept in the batch and folded into the media when
+ * it is full at the next sample or temperature_fold() is called.
+ *
+ * The sensor converts while the micro sleeps: the conversion is
+ * started here in the background and read, in the background too,
+ * at the first wakeup TEMP_CONVERSION later, the next minute. If
+ * the start failed the sample is read waiting for it.
+ *
+ * \param progs the programs struct.
+ * \param tnow the time now.
+ */
+void temperature_update(struct programs_t *progs, const time_t tnow)
+{
+	/* time of the last sample */
+	static time_t tlast = 0;
+	/* minutes of the conversion started */
+	static uint8_t minutes;
+	/* a conversion has been started, to be read */
+	static uint8_t converting = FALSE;
+
+	if (tnow < sample_next)
+		return;
+
+	if (converting) {
+		converting = FALSE;
+		sample_next = tlast + TEMP_SAMPLE_PERIOD;
+
+		if (batch_n == TEMP_BATCH)
+			temperature_fold(progs);
+
+		/* the conversion started */
+		if (!tcn75_wait())
+			tcn75_sample(&batch_sample[batch_n]);
+		else
+			batch_sample[batch_n] = tcn75_read_temperature();
+
+		batch_minutes[batch_n++] = minutes;
+		return;
+	}
+
+	minutes = 1;
+
+	if (tlast && (tnow > tlast)) {
+		if ((tnow - tlast) / 60 > TMEDIA_MAX_MINUTES)
+			minutes = TMEDIA_MAX_MINUTES;
+		else if ((tnow - tlast) / 60)
+			minutes = (tnow - tlast) / 60;
+	}
+
+	tlast = tnow;
+	tcn75_convert();
+	converting = TRUE;
+	sample_next = tnow + TEMP_CONVERSION;
+}
+
+/*! \brief when the next sample is due.
+ *
+ * \return the time, 0 before the first sample.
+ */
+time_t temperature_next(void)
+{
+	return(sample_next);
+}
+
+/*! \brief print a temperature or a factor with 5 decimals.
+ */
+static void print_temp(const temp_t t, struct debug_t *debug)
+{
+#ifdef TEMP_FLOAT
+	debug->line = dtostrf(t, 3, 5, debug->line);
+	debug_print(debug);
+#else
+	unsigned long u;
+
+	u = (t < 0) ? -t : t;
+
+	if (t < 0)
+		debug_putc('-', debug);
+
+	debug_print_num(u >> 16, 10, 0, ' ', debug);
+	debug_putc('.', debug);
+	/* 100000/65536 = 3125/2048 */
+	debug_print_num(((u & 0xffff) * 3125UL) >> 11, 10, 5, '0', debug);
+#endif
 }
 
 /*! print the temperature.
  */
 void temperature_print(struct programs_t *progs, struct debug_t *debug)
 {
-	if (progs->tnow == -99) {
+	if (progs->tnow == TNOW_INIT) {
 		debug_print_P(PSTR("Not available!\n"), debug);
 	} else {
 		debug_print_P(PSTR("Temperature: "), debug);
-		debug->line = dtostrf(progs->tnow, 3, 5, debug->line);
-		debug_print(debug);
+		print_temp(progs->tnow, debug);
 		debug_print_P(PSTR(","), debug);
-		debug->line = dtostrf(progs->tmedia, 3, 5, debug->line);
-		debug_print(debug);
+		print_temp(progs->tmedia, debug);
 		debug_print_P(PSTR(","), debug);
-		debug->line = dtostrf(progs->dfactor, 3, 5, debug->line);
-		debug_print(debug);
+		print_temp(progs->dfactor, debug);
 		debug_print_P(PSTR("\n"), debug);
 	}
 }
@@ -27,11 +27,32 @@
 #include "debug.h"
 
 /*! \brief temperature media at boot time */
-#define TMEDIA_INIT 15
-/*! initial value. */
-#define TNOW_INIT -99
+#define TMEDIA_INIT TEMP(15)
+/*! initial value, no temperature read. */
+#define TNOW_INIT TEMP(-99)
 /*! delay factor initial value. */
-#define DFACTOR_INIT 0
+#define DFACTOR_INIT TEMP(0)
+
+/*! \brief seconds between two temperature samples.
+ *
+ * The media moves by about 2% of the difference in 30 minutes.
+ * The sensor is sampled on its own schedule, not at every check
+ * of the programs.
+ */
+#define TEMP_SAMPLE_PERIOD 1800
+/*! \brief seconds from the start of a conversion to its read.
+ *
+ * More than TCN_TSAMPLE, the wakeup is rounded up to the next
+ * minute by prog_wakeup().
+ */
+#define TEMP_CONVERSION 1
+/*! samples kept before they are folded into the media. */
+#define TEMP_BATCH 4
+/*! Maximum minutes a single sample stands for in the media. */
+#define TMEDIA_MAX_MINUTES (TEMP_SAMPLE_PERIOD / 60)
+#if TMEDIA_MAX_MINUTES > 255
+#error TEMP_SAMPLE_PERIOD too long
+#endif
 
 /*! \brief temperature media weight.
  *
@@ -42,10 +63,13 @@
 #define TMEDIA_WSING 0.0007
 /*! media wall */
 #define TMEDIA_WALL 0.9993
+/*! single sample weight in Q0.24 for the fixed point media. */
+#define TMEDIA_WSING_Q24 ((int32_t)(TMEDIA_WSING * 16777216.0))
 
 /*! The formula is:
  * dfactor = (temperature media - TMEDIA_BASE)/TMEDIA_RATIO + 1
- * \note keep this float
+ * \note keep this float, in fixed point the division is a
+ * multiply by 1/TMEDIA_RATIO computed by the compiler.
  */
 #define TMEDIA_RATIO_FS 5.0
 /*! ratio hs */
@@ -59,7 +83,9 @@
 /*! media base sw */
 #define TMEDIA_BASE_SW 15.0
 
-void temperature_update(struct programs_t *progs);
+void temperature_update(struct programs_t *progs, const time_t tnow);
+void temperature_fold(struct programs_t *progs);
+time_t temperature_next(void);
 void temperature_print(struct programs_t *progs, struct debug_t *debug);
 void temperature_init(void);
 
@@ -28,11 +28,11 @@
 /*! main */
 int main(void)
 {
+	static struct programs_t progs_pool;
 	struct programs_t *progs;
 	uint8_t i;
 
-	/* anti warning for non initialized variables */
-	progs = malloc(sizeof(struct programs_t));
+	progs = &progs_pool;
 	progs->valve = BISTABLE;
 	progs->ioline = 0;
 
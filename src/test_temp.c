@@ -0,0 +1,175 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file test_temp.c
+ * \brief Test of the fixed point temperature against the float one.
+ *
+ * The simulated sensor reads the same pseudo random temperatures
+ * in both builds, TEST_SAMPLES for each sun site. Each sample is
+ * folded at once, then the media and the drift factor are printed.
+ * Then q_push() queues TEST_SAMPLES programs of random duration and
+ * drift factor, and the queued durations are printed.
+ *
+ * Host only, make test_temp_host builds it twice: with
+ * -D TEMP_FLOAT it prints, else it reads the float lines on stdin,
+ * compares them with its own and fails above TEST_TMEDIA_TOL,
+ * TEST_DFACTOR_TOL or TEST_DURATION_TOL.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "host/sim.h"
+#include "temperature.h"
+#include "queue.h"
+#include "journal.h"
+
+/*! samples a sun site and durations */
+#define TEST_SAMPLES 5000
+/*! max difference of the media in Celsius */
+#define TEST_TMEDIA_TOL 0.003
+/*! max difference of the drift factor */
+#define TEST_DFACTOR_TOL 0.0014
+/*! max difference of a duration in seconds */
+#define TEST_DURATION_TOL 1
+
+/*! the programs */
+static struct programs_t progs;
+#ifndef TEMP_FLOAT
+/*! failed checks */
+static unsigned long errors;
+#endif
+
+/*! no io lines, always free. */
+uint8_t io_free(const uint8_t oline, struct programs_t *progs)
+{
+	return(TRUE);
+}
+
+/*! no io lines. */
+void io_set(const uint8_t oline, const uint8_t onoff, struct programs_t *progs)
+{
+}
+
+/*! no journal. */
+void journal_add(struct programs_t *progs, const uint8_t event,
+		const uint8_t oline)
+{
+}
+
+/*! a temp_t in double. */
+static double temp_double(const temp_t t)
+{
+#ifdef TEMP_FLOAT
+	return(t);
+#else
+	return(t / 65536.0);
+#endif
+}
+
+/*! pseudo random in [lo, hi]. */
+static double test_rand(const double lo, const double hi)
+{
+	return(lo + (hi - lo) * rand() / RAND_MAX);
+}
+
+/*! \brief print or check a line.
+ *
+ * \param site the sun site, or 0xff for a duration.
+ * \param a the media, or the drift factor of the duration.
+ * \param b the drift factor, or the duration.
+ */
+static void test_line(const uint8_t site, const double a, const double b)
+{
+#ifdef TEMP_FLOAT
+	printf("%u %.9f %.9f\n", site, a, b);
+#else
+	unsigned int fsite;
+	double fa, fb;
+
+	if (scanf("%u %lf %lf", &fsite, &fa, &fb) != 3) {
+		printf("no float line\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (site == 0xff) {
+		if ((fsite != site) || (fabs(fb - b) > TEST_DURATION_TOL)) {
+			printf("dfactor %f duration %.0f, float %.0f\n",
+					a, b, fb);
+			errors++;
+		}
+	} else if ((fsite != site) || (fabs(fa - a) > TEST_TMEDIA_TOL) ||
+			(fabs(fb - b) > TEST_DFACTOR_TOL)) {
+		printf("site %u tmedia %f dfactor %f, float %f %f\n",
+				site, a, b, fa, fb);
+		errors++;
+	}
+#endif
+}
+
+/*! main */
+int main(void)
+{
+	struct tm tm_clock;
+	time_t t;
+	uint16_t i, dmin;
+	double factor;
+	uint8_t site;
+
+	srand(1);
+	t = 1400000000UL;
+
+	for (site = FULLSUN; site <= SHADOW; site++) {
+		progs.position = site;
+		progs.tmedia = TMEDIA_INIT;
+
+		for (i = 0; i < TEST_SAMPLES; i++) {
+			sim.temperature = test_rand(-10.0, 45.0);
+			/* the conversion starts, it is read the next minute */
+			temperature_update(&progs, t);
+			temperature_update(&progs, t + 60);
+			t += TEMP_SAMPLE_PERIOD;
+			temperature_fold(&progs);
+			test_line(site, temp_double(progs.tmedia),
+					temp_double(progs.dfactor));
+		}
+	}
+
+	/* every day, the program is queued today */
+	prog_set(&progs.p[0], 0, 0, 0, 0x7f, 0);
+
+	for (i = 0; i < TEST_SAMPLES; i++) {
+		dmin = rand() % 1024;
+		factor = test_rand(0.0, PROG_MAX_FACTOR);
+		prog_set(&progs.p[0], 0, 0, dmin, 0x7f, 0);
+		progs.dfactor = TEMP(factor);
+		progs.qc = 0;
+		tm_clock = *gmtime(&t);
+		q_push(&progs, &tm_clock, 0);
+		test_line(0xff, factor, progs.qc ?
+				progs.q[0].stop - progs.q[0].start : 0);
+	}
+
+#ifndef TEMP_FLOAT
+	printf("%lu errors\n", errors);
+
+	if (errors)
+		return(EXIT_FAILURE);
+#endif
+
+	return(EXIT_SUCCESS);
+}
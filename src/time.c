@@ -30,10 +30,14 @@
    but time returns the seconds since 1970 */
 
 static const unsigned char monthDays[] PROGMEM = {31,28,31,30,31,30,31,31,30,31,30,31};
+/* days before the month in a year starting on March */
+static const uint16_t monthOffset[] PROGMEM = {0,31,61,92,122,153,184,214,245,275,306,337};
 char * __month[]={"Jan","Feb","Mar","Apr","May","Jun", "Jul","Aug","Sep","Oct","Nov","Dec"};
 char * __day[]={"Sun","Mon","Tue","Wed","Thu","Fri","Sat"};
 static char ascTimeBuffer[32];
 static struct tm lastTime;
+/* the calendar time lastTime is referred to */
+static time_t lastEpoch;
 
 /*! C lib settimeofday */
 void settimeofday(const time_t seconds) {
@@ -77,17 +81,81 @@ char *asctime(struct tm *timeptr) {
 	return(ascTimeBuffer);
 }
 
+/*! \brief days since CIVIL_BASE_DAYS to year, month and day.
+ *
+ * Constant time, 16 bit only, no year or month walk.
+ * Every 4 years are 1461 days with the leap day at the end,
+ * the missing 2100 leap day is put back before the split.
+ *
+ * \param days since the 1st of March 1968.
+ * \param timeptr where to store year, month, day and day of the year.
+ */
+static void civil_from_days(unsigned int days, struct tm *timeptr) {
+	unsigned int doy;
+	unsigned char yoe, mp;
+
+	if (days >= CIVIL_2100_DAYS)
+		days++;
+
+	/* year of the 4 years cycle, the leap day is 1460 */
+	doy = days % 1461;
+	yoe = (doy - doy/1460) / 365;
+	/* day and month of the year starting on March */
+	doy -= yoe * 365;
+	mp = (5 * doy + 2) / 153;
+
+	timeptr->tm_year = 68 + (days / 1461) * 4 + yoe;
+	timeptr->tm_mday = doy - pgm_read_word(&(monthOffset[mp])) + 1;
+
+	if (mp < 10) {
+		timeptr->tm_mon = mp + 2;
+		timeptr->tm_yday = doy + 59 + LEAP_YEAR(timeptr->tm_year + 1900);
+	} else {
+		timeptr->tm_mon = mp - 10;
+		timeptr->tm_year++;
+		timeptr->tm_yday = doy - 306;
+	}
+}
+
+/*! \brief year, month and day to days since CIVIL_BASE_DAYS.
+ *
+ * The inverse of civil_from_days().
+ *
+ * \param year from 1970 to 2106.
+ * \param month 0..11.
+ * \param mday 1..31.
+ */
+static unsigned int days_from_civil(int year, unsigned char month, unsigned char mday) {
+	unsigned int days;
+	unsigned char mp;
+
+	/* January and February are the end of the previous year */
+	if (month < 2) {
+		year--;
+		mp = month + 10;
+	} else {
+		mp = month - 2;
+	}
+
+	year -= 1968;
+	days = (unsigned int)year * 365 + year / 4;
+	days += pgm_read_word(&(monthOffset[mp])) + mday - 1;
+
+	if (days >= CIVIL_2100_DAYS)
+		days--;
+
+	return(days);
+}
+
 /*! convert calendar time (seconds since 1970) to broken-time.
  *
  * This only works for dates between 01-01-1970 00:00:00 and
- * 19-01-2038 03:14:07
+ * 07-02-2106 06:28:15
  */
 struct tm *gmtime(time_t *timep) {
 	unsigned long epoch=*timep;
-	unsigned int year;
-	unsigned char month, monthLength;
-	unsigned long days;
 
+	lastEpoch=epoch;
 	lastTime.tm_sec=epoch%60;
 	epoch/=60; /* now it is minutes */
 	lastTime.tm_min=epoch%60;
@@ -96,44 +164,74 @@ struct tm *gmtime(time_t *timep) {
 	epoch/=24; /* now it is days */
 	lastTime.tm_wday=(epoch+4)%7;
 
-	year=1970;
-	days=0;
+	civil_from_days(epoch + CIVIL_BASE_DAYS, &lastTime);
 
-	while ((days += (LEAP_YEAR(year) ? 366 : 365)) <= epoch) {
-		year++;
-	}
+	return(&lastTime);
+}
 
-	lastTime.tm_year=year-1900;
-
-	days -= LEAP_YEAR(year) ? 366 : 365;
-	epoch -= days; /* now it is days in this year, starting at 0 */
-	lastTime.tm_yday=epoch;
-
-	days=0;
-	month=0;
-	monthLength=0;
-
-	for (month=0; month<12; month++) {
-		if (month==1) { /* february */
-			if (LEAP_YEAR(year)) {
-				monthLength=29;
-			} else {
-				monthLength=28;
-			}
-		} else {
-			monthLength = pgm_read_byte(&(monthDays[month]));
-		}
+/*! move lastTime to the next day. */
+static void NextDay(void) {
+	unsigned char monthLength;
+
+	if (++lastTime.tm_wday > 6)
+		lastTime.tm_wday=0;
 
-		if (epoch>=monthLength) {
-			epoch-=monthLength;
-		} else {
-			break;
+	lastTime.tm_yday++;
+
+	if (lastTime.tm_mon==1 && LEAP_YEAR(lastTime.tm_year+1900))
+		monthLength=29;
+	else
+		monthLength=pgm_read_byte(&(monthDays[lastTime.tm_mon]));
+
+	if (++lastTime.tm_mday > monthLength) {
+		lastTime.tm_mday=1;
+
+		if (++lastTime.tm_mon > 11) {
+			lastTime.tm_mon=0;
+			lastTime.tm_year++;
+			lastTime.tm_yday=0;
 		}
 	}
+}
+
+/*! \brief broken-down time of the RTC clock.
+ *
+ * Instead of converting the clock from scratch, lastTime is
+ * carried forward from the calendar time of the last conversion,
+ * the RTC moves 8 seconds per wake up so this is only a couple of
+ * compare. If the clock went back or moved more than an hour,
+ * usually because it has been set, fall back to gmtime().
+ *
+ * \return the pointer to lastTime, same as gmtime().
+ */
+struct tm *gmtime_now(void) {
+	time_t now;
+	unsigned int carry;
+
+	now=gettimeofday();
+
+	if ((now < lastEpoch) || (now - lastEpoch >= 3600))
+		return(gmtime(&now));
+
+	carry=lastTime.tm_sec + (unsigned int)(now - lastEpoch);
+	lastEpoch=now;
+
+	if (carry < 60) {
+		lastTime.tm_sec=carry;
+		return(&lastTime);
+	}
 
-	lastTime.tm_mon=month;
-	lastTime.tm_mday=epoch+1;
+	lastTime.tm_sec=carry%60;
+	carry=lastTime.tm_min + carry/60;
+	lastTime.tm_min=carry%60;
+	carry=lastTime.tm_hour + carry/60;
+
+	if (carry > 23) {
+		carry-=24;
+		NextDay();
+	}
 
+	lastTime.tm_hour=carry;
 	return(&lastTime);
 }
 
@@ -144,31 +242,13 @@ char *ctime(time_t *timep) {
 
 /*! convert broken time to calendar time (seconds since 1970) */
 time_t mktime(struct tm *timeptr) {
-	int year=timeptr->tm_year+1900;
-	int month=timeptr->tm_mon;
-	int i;
-	long seconds;
+	unsigned long seconds;
 
 	CheckTime(timeptr);
 
-	/* seconds from 1970 till 1 jan 00:00:00 this year */
-	seconds= (year-1970)*31536000L; /* 60*60*24L*365 */
-
-	/* add extra days for leap years */
-	for (i=1970; i<year; i++)
-		if (LEAP_YEAR(i))
-			seconds+= 86400L; /* 60*60*24L */
-
-	/* add days for this year */
-	for (i=0; i<month; i++) {
-		if (i==1 && LEAP_YEAR(year)) { 
-			seconds+= 2505600L; /* 60*60*24L*29 */
-		} else {
-			seconds+= 86400L * pgm_read_byte(&(monthDays[i]));
-		}
-	}
-
-	seconds+= (timeptr->tm_mday-1) * 86400L;
+	seconds = days_from_civil(timeptr->tm_year+1900, timeptr->tm_mon,
+			timeptr->tm_mday) - CIVIL_BASE_DAYS;
+	seconds*= 86400L; /* 60*60*24L */
 	seconds+= timeptr->tm_hour * 3600L;
 	seconds+= timeptr->tm_min*60;
 	seconds+= timeptr->tm_sec;
@@ -34,9 +34,20 @@
 #include "rtc.h"
 
 /*! A leap year is ((((year%4)==0) && ((year%100)!=0)) || ((year%400)==0))
- * but since we have no fancy years between 1970 and 2038 we can do:
+ * the unsigned time_t ends on 2106, so 2100 is the only fancy year.
  */
-#define LEAP_YEAR(year) ((year%4)==0)
+#define LEAP_YEAR(year) ((((year)%4)==0) && ((year)!=2100))
+
+/*! \brief Base of the day count used in the conversions.
+ *
+ * The 1st of March 1968, the leap day is the last day of a year
+ * counted from March. It is 671 days before the epoch.
+ */
+#define CIVIL_BASE_DAYS 671
+/*! Days from CIVIL_BASE_DAYS to the 1st of March 2100, the missing
+ * 29th of February 2100 is right before it.
+ */
+#define CIVIL_2100_DAYS 48212
 
 /*! The standard struct tm. */
 struct tm {
@@ -65,6 +76,7 @@ void settimeofday(const time_t seconds);
 time_t gettimeofday(void);
 time_t time(time_t *t);
 struct tm *gmtime(time_t *timep);
+struct tm *gmtime_now(void);
 time_t mktime(struct tm *timeptr);
 char *asctime(struct tm *timeptr);
 char *ctime(time_t *timep);
@@ -16,94 +16,254 @@
  */
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include "uart.h"
 
+/*! IO buffers of the ports, see UART_PORTS. */
+static struct uartStruct uart[UART_PORTS];
+/*! baud rate of the ports, applied by uart_init(). */
+static uint32_t baud_rate[UART_PORTS] = {
+	UART_BAUD_0,
+#ifdef UART_PORT1
+	UART_BAUD_1,
+#endif
+};
+
+/*! store a received char, dropped if the buffer is full. */
+static void rx_store(struct uartStruct *u, const char c)
+{
+	uint8_t next;
+
+	next = (u->rx_head + 1) & UART_RXBUF_MASK;
+
+	if (next != u->rx_tail) {
+		u->rx_buffer[u->rx_head] = c;
+		u->rx_head = next;
+	}
+}
+
+/*! char received on port 0. */
+ISR(USART0_RX_vect)
+{
+	rx_store(&uart[0], UDR0);
+}
+
+/*! port 0 ready to send, next char or stop. */
+ISR(USART0_UDRE_vect)
+{
+	if (uart[0].tx_head != uart[0].tx_tail) {
+		UDR0 = uart[0].tx_buffer[uart[0].tx_tail];
+		uart[0].tx_tail = (uart[0].tx_tail + 1) & UART_TXBUF_MASK;
+	} else {
+		UCSR0B &= ~_BV(UDRIE0);
+	}
+}
+
+#ifdef UART_PORT1
+/*! char received on port 1. */
+ISR(USART1_RX_vect)
+{
+	rx_store(&uart[1], UDR1);
+}
+
+/*! port 1 ready to send, next char or stop. */
+ISR(USART1_UDRE_vect)
+{
+	if (uart[1].tx_head != uart[1].tx_tail) {
+		UDR1 = uart[1].tx_buffer[uart[1].tx_tail];
+		uart[1].tx_tail = (uart[1].tx_tail + 1) & UART_TXBUF_MASK;
+	} else {
+		UCSR1B &= ~_BV(UDRIE1);
+	}
+}
+#endif
+
+/*! \brief send a char of the tx buffer without the interrupt.
+ *
+ * With the interrupts disabled, like during the boot, the buffer
+ * is emptied by hand.
+ */
+static void tx_poll(const uint8_t port)
+{
+#ifdef UART_PORT1
+	if (port) {
+		loop_until_bit_is_set(UCSR1A, UDRE1);
+		UDR1 = uart[1].tx_buffer[uart[1].tx_tail];
+		uart[1].tx_tail = (uart[1].tx_tail + 1) & UART_TXBUF_MASK;
+	} else
+#endif
+	{
+		loop_until_bit_is_set(UCSR0A, UDRE0);
+		UDR0 = uart[0].tx_buffer[uart[0].tx_tail];
+		uart[0].tx_tail = (uart[0].tx_tail + 1) & UART_TXBUF_MASK;
+	}
+}
+
+/*! \brief change the baud rate of a port.
+ *
+ * What is in the tx buffer is sent at the old rate first. Not
+ * saved, at the next boot the rate is UART_BAUD_0 or UART_BAUD_1.
+ *
+ * \param port
+ * \param baud check it with uart_ubrr() first.
+ */
+void uart_baud(const uint8_t port, const uint32_t baud)
+{
+	uart_shutdown(port);
+	baud_rate[UART_IDX(port)] = baud;
+	uart_init(port);
+}
+
+/*! the baud rate of a port. */
+uint32_t uart_baud_get(const uint8_t port)
+{
+	return(baud_rate[UART_IDX(port)]);
+}
+
 /*! Init the uart port. */
 void uart_init(const uint8_t port)
 {
+	uint16_t ubrr;
+
+	uart[UART_IDX(port)].rx_head = 0;
+	uart[UART_IDX(port)].rx_tail = 0;
+	uart[UART_IDX(port)].tx_head = 0;
+	uart[UART_IDX(port)].tx_tail = 0;
+	uart_ubrr(baud_rate[UART_IDX(port)], &ubrr);
+
+#ifdef UART_PORT1
 	if (port) {
-		/* improve baud rate error by using 2x clk */
-#if F_CPU < 2000000UL && defined(U2X1)
-		UCSR1A = _BV(U2X1);
-		UBRR1L = (F_CPU / (8UL * UART_BAUD_1)) - 1;
-#else
-		UBRR1L = (F_CPU / (16UL * UART_BAUD_1)) - 1;
-#endif
+		if (ubrr & UART_U2X)
+			UCSR1A = _BV(U2X1);
+		else
+			UCSR1A = 0;
+
+		UBRR1H = (ubrr >> 8) & 0x0f;
+		UBRR1L = ubrr;
 
-		/*! tx/rx enable */
-		UCSR1B = _BV(TXEN1) | _BV(RXEN1);
+		/*! tx/rx enable, rx interrupt */
+		UCSR1B = _BV(TXEN1) | _BV(RXEN1) | _BV(RXCIE1);
 		/* 8n2 */
 		UCSR1C = _BV(USBS1) | _BV(UCSZ10) | _BV(UCSZ11);
-	} else {
-		/* improve baud rate error by using 2x clk */
-#if F_CPU < 2000000UL && defined(U2X0)
-		UCSR0A = _BV(U2X0);
-		UBRR0L = (F_CPU / (8UL * UART_BAUD_0)) - 1;
-#else
-		UBRR0L = (F_CPU / (16UL * UART_BAUD_0)) - 1;
+	} else
 #endif
+	{
+		if (ubrr & UART_U2X)
+			UCSR0A = _BV(U2X0);
+		else
+			UCSR0A = 0;
+
+		UBRR0H = (ubrr >> 8) & 0x0f;
+		UBRR0L = ubrr;
 
-		/*! tx/rx enable */
-		UCSR0B = _BV(TXEN0) | _BV(RXEN0);
+		/*! tx/rx enable, rx interrupt */
+		UCSR0B = _BV(TXEN0) | _BV(RXEN0) | _BV(RXCIE0);
 		/* 8n2 */
 		UCSR0C = _BV(USBS0) | _BV(UCSZ00) | _BV(UCSZ01);
 	}
 }
 
-/*! Disable the uart port. */
+/*! Disable the uart port, after the tx buffer has been sent. */
 void uart_shutdown(const uint8_t port)
 {
+	while (uart[UART_IDX(port)].tx_head != uart[UART_IDX(port)].tx_tail)
+		if (!(SREG & _BV(SREG_I)))
+			tx_poll(port);
+
+#ifdef UART_PORT1
 	if (port) {
+		loop_until_bit_is_set(UCSR1A, UDRE1);
 		UCSR1C = 0;
 		UCSR1B = 0;
+		UBRR1H = 0;
 		UBRR1L = 0;
 		UCSR1A = 0;
-	} else {
+	} else
+#endif
+	{
+		loop_until_bit_is_set(UCSR0A, UDRE0);
 		UCSR0C = 0;
 		UCSR0B = 0;
+		UBRR0H = 0;
 		UBRR0L = 0;
 		UCSR0A = 0;
 	}
 }
 
-/*! Get a char from the uart port. */
+/*! \brief Get a char from the uart port.
+ *
+ * \param port
+ * \param locked wait for a char.
+ * \return the char, 0 if there is none and not locked.
+ */
 char uart_getchar(const uint8_t port, const uint8_t locked)
 {
-	if (locked) {
-		if (port) {
-			loop_until_bit_is_set(UCSR1A, RXC1);
-			return(UDR1);
-		} else {
-			loop_until_bit_is_set(UCSR0A, RXC0);
-			return(UDR0);
-		}
-	} else {
-		if (port) {
-			if (bit_is_set(UCSR1A, RXC1))
-				return(UDR1);
-			else
-				return(0);
-		} else {
-			if (bit_is_set(UCSR0A, RXC0))
-				return(UDR0);
-			else
-				return(0);
-		}
-	}
+	struct uartStruct *u;
+	char c;
+
+	u = &uart[UART_IDX(port)];
+
+	if (locked)
+		while (u->rx_head == u->rx_tail);
+
+	if (u->rx_head == u->rx_tail)
+		return(0);
+
+	c = u->rx_buffer[u->rx_tail];
+	u->rx_tail = (u->rx_tail + 1) & UART_RXBUF_MASK;
+
+	return(c);
 }
 
-/*! Send character c down the UART Tx, wait until tx holding register
- * is empty.
+/*! \brief Get a byte from the rx buffer, without waiting.
+ *
+ * Unlike uart_getchar() a 0 is a valid byte.
+ *
+ * \param port
+ * \param c the byte.
+ * \return TRUE if there was one.
+ */
+uint8_t uart_rx(const uint8_t port, char *c)
+{
+	struct uartStruct *u;
+
+	u = &uart[UART_IDX(port)];
+
+	if (u->rx_head == u->rx_tail)
+		return(0);
+
+	*c = u->rx_buffer[u->rx_tail];
+	u->rx_tail = (u->rx_tail + 1) & UART_RXBUF_MASK;
+
+	return(1);
+}
+
+/*! \brief Put character c into the tx buffer.
+ *
+ * It waits only if the buffer is full, the interrupt sends the
+ * chars in the background.
  */
 void uart_putchar(const uint8_t port, const char c)
 {
-  if (port) {
-	  loop_until_bit_is_set(UCSR1A, UDRE1);
-	  UDR1 = c;
-  } else {
-	  loop_until_bit_is_set(UCSR0A, UDRE0);
-	  UDR0 = c;
-  }
+	struct uartStruct *u;
+	uint8_t next;
+
+	u = &uart[UART_IDX(port)];
+	next = (u->tx_head + 1) & UART_TXBUF_MASK;
+
+	while (next == u->tx_tail)
+		if (!(SREG & _BV(SREG_I)))
+			tx_poll(port);
+
+	u->tx_buffer[u->tx_head] = c;
+	u->tx_head = next;
+
+#ifdef UART_PORT1
+	if (port)
+		UCSR1B |= _BV(UDRIE1);
+	else
+#endif
+		UCSR0B |= _BV(UDRIE0);
 }
 
 /*! Send a C (NUL-terminated) string down the UART Tx.
@@ -22,10 +22,57 @@
 #ifndef _UART_H_
 #define _UART_H_
 
-/*! UART 0 baud rate */
+#include <stdint.h>
+
+#ifndef UART_BAUD_0
+/*! UART 0 baud rate at boot, see the Makefile. */
 #define UART_BAUD_0 9600
-/*! UART 1 baud rate */
+#endif
+#ifndef UART_BAUD_1
+/*! UART 1 baud rate at boot. */
 #define UART_BAUD_1 9600
+#endif
+/*! \brief max baud rate error in 0.1%.
+ *
+ * Both sides can be wrong, 2% each is the usual limit for 8n2.
+ */
+#define UART_BAUD_TOL 20
+/*! double speed flag in the divisor returned by uart_ubrr(). */
+#define UART_U2X 0x8000
+
+/*! divisor, rounded, of a baud rate with x clocks per bit. */
+#define UART_DIV(b, x) ((F_CPU + (x) * (b) / 2) / ((x) * (b)))
+/*! real baud rate with x clocks per bit. */
+#define UART_REAL(b, x) (F_CPU / ((x) * UART_DIV(b, x)))
+/*! the baud rate can be done within UART_BAUD_TOL. */
+#define UART_BAUD_OK(b, x) \
+	((UART_REAL(b, x) * 1000 <= (b) * (1000 + UART_BAUD_TOL)) && \
+	 (UART_REAL(b, x) * 1000 >= (b) * (1000 - UART_BAUD_TOL)))
+
+#if !UART_BAUD_OK(UART_BAUD_0, 16) && !UART_BAUD_OK(UART_BAUD_0, 8)
+#error "UART_BAUD_0 cannot be done within UART_BAUD_TOL at this F_CPU"
+#endif
+#if !UART_BAUD_OK(UART_BAUD_1, 16) && !UART_BAUD_OK(UART_BAUD_1, 8)
+#error "UART_BAUD_1 cannot be done within UART_BAUD_TOL at this F_CPU"
+#endif
+
+#ifdef UART_PORT1
+/*! ports with the buffers, see the Makefile. */
+#define UART_PORTS 2
+/*! the buffers and the baud rate of a port. */
+#define UART_IDX(port) (port)
+#else
+/*! \brief ports with the buffers.
+ *
+ * Only port 0 is in use, the buffers of port 1 take RAM for
+ * nothing. Build with -D UART_PORT1 to have it, else any port is
+ * port 0.
+ */
+#define UART_PORTS 1
+/*! the buffers and the baud rate of a port. */
+#define UART_IDX(port) 0
+#endif
+
 /*! IO Buffers and masks */
 #define UART_RXBUF_SIZE 64
 /*! IO Buffers and masks */
@@ -43,25 +90,33 @@
 #error TX buffer size is not a power of 2
 #endif
 
-/*! Structure with IO buffers and indexes */
+/*! \brief Structure with IO buffers and indexes.
+ *
+ * Two ring buffers, empty when head == tail. The rx head and the
+ * tx tail are moved by the interrupts only.
+ */
 struct uartStruct {
 	/*! receive buffer. */
-        char *rx_buffer;
+	char rx_buffer[UART_RXBUF_SIZE];
 	/*! transmit buffer. */
-        char *tx_buffer;
-	/*! flags. */
-        volatile uint8_t rx_flag;
-	/*! flags. */
-        volatile uint8_t tx_flag;
-	/*! flags. */
-        volatile uint8_t rxIdx;
-	/*! flags. */
-        volatile uint8_t txIdx;
+	char tx_buffer[UART_TXBUF_SIZE];
+	/*! next char received goes here. */
+	volatile uint8_t rx_head;
+	/*! next char to be read. */
+	volatile uint8_t rx_tail;
+	/*! next char to be sent goes here. */
+	volatile uint8_t tx_head;
+	/*! next char to be sent. */
+	volatile uint8_t tx_tail;
 };
 
+int16_t uart_ubrr(const uint32_t baud, uint16_t *ubrr);
+void uart_baud(const uint8_t port, const uint32_t baud);
+uint32_t uart_baud_get(const uint8_t port);
 void uart_init(const uint8_t port);
 void uart_shutdown(const uint8_t port);
 char uart_getchar(const uint8_t port, const uint8_t locked);
+uint8_t uart_rx(const uint8_t port, char *c);
 void uart_putchar(const uint8_t port, const char c);
 void uart_printstr(const uint8_t port, const char *s);
 
@@ -0,0 +1,68 @@
+/* This file is part of OpenGarden
+ * Copyright (C) 2014 Enrico Rossi
+ *
+ * OpenGarden is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * OpenGarden is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file uart_ubrr.c
+ * \brief Baud rate divisor of the uart, no hardware involved.
+ *
+ * Linked by the firmware and by the host build, see host/uart.c.
+ */
+
+#include <stdint.h>
+#include "uart.h"
+
+/*! \brief the divisor of a baud rate.
+ *
+ * Both the normal (16 clocks per bit) and the double speed
+ * (8 clocks) divisors are rounded to the nearest, the one with the
+ * lower error wins, the normal one on a tie since it samples each
+ * bit 3 times.
+ *
+ * \param baud the baud rate, not 0.
+ * \param ubrr the UBRR value, UART_U2X set for double speed.
+ * \return the error in 0.1%, positive if faster than baud.
+ */
+int16_t uart_ubrr(const uint32_t baud, uint16_t *ubrr)
+{
+	uint32_t div, real;
+	int32_t err, best;
+	uint8_t x;
+
+	best = INT16_MAX;
+
+	for (x = 16; x >= 8; x -= 8) {
+		div = (F_CPU + x * baud / 2) / (x * baud);
+
+		/* 12 bit UBRR */
+		if (!div)
+			div = 1;
+		else if (div > 4096)
+			div = 4096;
+
+		real = F_CPU / (x * div);
+		err = ((int32_t)real - (int32_t)baud) * 1000 / (int32_t)baud;
+
+		if (err > INT16_MAX)
+			err = INT16_MAX;
+
+		if ((err < 0 ? -err : err) < (best < 0 ? -best : best)) {
+			best = err;
+			*ubrr = (div - 1) | (x == 8 ? UART_U2X : 0);
+		}
+	}
+
+	return(best);
+}